@@ -3,6 +3,10 @@
 // 1. Complex number arithmetic (specifically, squaring complex numbers).
 // 2. Iterative processes and escape-time algorithms.
 // 3. Mapping mathematical results to visual colors.
+// 4. Splitting the image into tiles and rendering them on several threads.
+// 5. Measuring the renderer with a small benchmark harness.
+// 6. Estimating the distance to the set's boundary to draw its thin filaments.
+// 7. Fixed-point arithmetic for results that are identical on every build.
 //
 // The Mandelbrot set is a fascinating fractal defined by a simple iterative process.
 // For each complex number 'c', we repeatedly apply the function z = z^2 + c,
@@ -10,10 +14,65 @@
 // stays bounded (doesn't grow infinitely large), then 'c' is part of the
 // Mandelbrot set. Otherwise, it is not. The colors will represent how quickly
 // 'z' escapes to infinity.
+//
+// Build:   g++ -std=c++17 -O3 -march=native -pthread cpp_guide_945d0d.cpp -o mandelbrot -lz
+//          (add -g -fsanitize=address for a build to run --self-test with)
+// Run:     ./mandelbrot [--kernel=NAME] [--threads=N] [--mode=escape|distance]
+//                       [--no-symmetry] [--schedule=predictive|uniform]
+//                       [--png=FILE.png] [--tile-stats=PREFIX]
+//                       [--huge-pages=transparent|explicit|off] [--numa=auto|on|off]
+//                       [--raw=FILE.iter [--raw-smooth]] [--quadtree=NODES]
+//                       [--checkpoint=FILE]   (rerun the same command to resume)
+// Raw:     ./mandelbrot --raw-info=FILE.iter [--png=FILE.png]   (summary, recolor)
+// Distributed: ./mandelbrot --distributed=WORKERS [--output=FILE.pgm] [--socket=PATH]
+//              ./mandelbrot --worker=PATH        (join a running coordinator)
+// Buddhabrot: ./mandelbrot --buddhabrot=SAMPLES [--sampler=uniform|metropolis]
+//                         [--snapshots=N] [--png=FILE.png]
+// Julia:   ./mandelbrot --julia-sweep=COLUMNSxROWS [--thumbnail=PIXELS] [--png=FILE.png]
+// Pyramid: ./mandelbrot --pyramid=NAME [--tile-size=PIXELS] [--memory-budget=MB]
+// Frame:   [--size=WIDTHxHEIGHT] [--view=MINRE,MAXRE,MINIM,MAXIM] [--max-iterations=N]
+// Measure: ./mandelbrot --benchmark [--benchmark_filter=TEXT]
+//                       [--benchmark_min_time=SECONDS] [--benchmark_out=FILE.json]
+// Check:   ./mandelbrot --self-test   (compares renders that must agree)
 
 #include <iostream> // For outputting information to the console.
 #include <complex>  // For using complex numbers. This is a standard C++ library.
 #include <vector>   // For storing the pixel data.
+#include <algorithm> // For std::min and std::max.
+#include <atomic>   // For handing out tiles to worker threads.
+#include <chrono>   // For timing benchmark runs.
+#include <cmath>    // For std::log and std::sqrt in the distance estimator.
+#include <cstdio>   // For std::printf in the benchmark table.
+#include <cstdlib>  // For std::atof and std::atoi.
+#include <cstring>  // For parsing command-line options.
+#include <ctime>    // For stamping benchmark reports with the date.
+#include <fstream>  // For writing benchmark reports.
+#include <random>   // For the random samples of the Buddhabrot.
+#include <string>   // For command-line options and kernel names.
+#include <thread>   // For rendering tiles in parallel.
+#include <cstdint>  // For fixed-size integers (fixed-point kernels, PNG format).
+#include <zlib.h>   // For deflate and the checksums in PNG files (link with -lz).
+#include <deque>    // For the queue of bands waiting for a worker.
+#include <queue>    // For the quadtree's cells, most promising first.
+#include <mutex>    // For the checkpoint file shared by the rendering threads.
+#include <sstream>  // For parsing the distributed rendering protocol.
+#include <new>      // For std::bad_alloc when a frame buffer cannot be mapped.
+#include <type_traits> // For checking that frame buffer pixels are plain data.
+
+// POSIX headers for distributed rendering (processes, sockets, shared files),
+// for creating the image pyramid's directories and for placing frame buffers
+// and threads on NUMA nodes.
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 // Define the dimensions of our image.
 const int IMAGE_WIDTH = 800;
@@ -30,16 +89,39 @@ const double MAX_IMAGINARY = 1.5;
 // A higher number gives more detail but takes longer to compute.
 const int MAX_ITERATIONS = 100;
 
+// Width and height (in pixels) of the square tiles the image is split into.
+// Each tile is one unit of work for a rendering thread.
+const int TILE_SIZE = 64;
+
+// Predictive scheduling probes every PROBE_STRIDE-th pixel in each direction,
+// i.e. 1/64 of the frame, to estimate what each tile will cost.
+const int PROBE_STRIDE = 8;
+
+// A tile predicted to cost more than 1/TILE_SPLIT_SHARE of one thread's fair
+// share of the frame is split into quarters (down to MIN_SPLIT_TILE_SIZE),
+// so no single tile can keep one thread busy long after the others finish.
+const int TILE_SPLIT_SHARE = 4;
+const int MIN_SPLIT_TILE_SIZE = 16;
+
+// Number of pixels the SIMD kernels advance in lockstep.
+// Four doubles fill one 256-bit AVX register.
+const int SIMD_LANES = 4;
+
+// Escape radius used by the distance estimator.
+// The estimate is only accurate once |z| is large, so we keep iterating well
+// past the radius of 2 that is enough to decide whether a point escapes.
+const double DISTANCE_ESCAPE_RADIUS = 1000.0;
+
 // Function to calculate the number of iterations before a complex number escapes.
 // 'c' is the complex number we are testing.
-// Returns the number of iterations, or MAX_ITERATIONS if it doesn't escape.
-int mandelbrotIterations(const std::complex<double>& c) {
+// Returns the number of iterations, or maxIterations if it doesn't escape.
+int mandelbrotIterations(const std::complex<double>& c, int maxIterations = MAX_ITERATIONS) {
     // Initialize z to 0. This is the starting point for the iteration.
     std::complex<double> z = 0;
 
     // The core of the Mandelbrot calculation: z = z^2 + c
-    // We perform this iteration up to MAX_ITERATIONS times.
-    for (int i = 0; i < MAX_ITERATIONS; ++i) {
+    // We perform this iteration up to maxIterations times.
+    for (int i = 0; i < maxIterations; ++i) {
         // Calculate z^2. The std::complex library handles this.
         // std::complex<double> z_squared = z * z; // Alternatively, you can do it this way.
         z = std::pow(z, 2) + c; // Use std::pow for squaring, or z * z
@@ -55,15 +137,70 @@ int mandelbrotIterations(const std::complex<double>& c) {
     }
     // If the loop completes without escaping, the point is considered to be
     // within the Mandelbrot set (or very close to it).
-    return MAX_ITERATIONS;
+    return maxIterations;
+}
+
+// The same escape-time loop written with plain doubles.
+// Writing z = x + yi out by hand gives z^2 = (x^2 - y^2) + 2xyi, and comparing
+// |z|^2 against 4 avoids the square root hidden inside std::abs. The return
+// value has the same meaning as mandelbrotIterations().
+int mandelbrotIterationsScalar(double cReal, double cImaginary, int maxIterations) {
+    double zReal = 0.0;
+    double zImaginary = 0.0;
+    for (int i = 0; i < maxIterations; ++i) {
+        double zRealSquared = zReal * zReal;
+        double zImaginarySquared = zImaginary * zImaginary;
+        zImaginary = 2.0 * zReal * zImaginary + cImaginary;
+        zReal = zRealSquared - zImaginarySquared + cReal;
+        if (zReal * zReal + zImaginary * zImaginary > 4.0) {
+            return i;
+        }
+    }
+    return maxIterations;
+}
+
+// Turns the final z and its derivative dz/dc into a distance estimate.
+// For a point outside the set, 0.5 * |z| * log|z| / |dz| approximates how far
+// 'c' is from the nearest point of the set, in the units of the complex plane.
+double distanceFromOrbit(double zMagnitudeSquared, double dzMagnitudeSquared) {
+    double zMagnitude = std::sqrt(zMagnitudeSquared);
+    return 0.5 * zMagnitude * std::log(zMagnitude) / std::sqrt(dzMagnitudeSquared);
+}
+
+// Distance estimation: iterate z = z^2 + c together with its derivative with
+// respect to c, dz = 2 * z * dz + 1 (the chain rule applied to z^2 + c).
+// A point whose orbit escapes gets the estimated distance to the boundary of
+// the set; a point that never escapes is inside and gets 0.
+double mandelbrotDistanceScalar(double cReal, double cImaginary, int maxIterations) {
+    const double radiusSquared = DISTANCE_ESCAPE_RADIUS * DISTANCE_ESCAPE_RADIUS;
+    double zReal = 0.0, zImaginary = 0.0;
+    double dzReal = 0.0, dzImaginary = 0.0;
+    for (int i = 0; i < maxIterations; ++i) {
+        // dz must be updated first because it uses the old value of z.
+        double newDzReal = 2.0 * (zReal * dzReal - zImaginary * dzImaginary) + 1.0;
+        dzImaginary = 2.0 * (zReal * dzImaginary + zImaginary * dzReal);
+        dzReal = newDzReal;
+
+        double zRealSquared = zReal * zReal;
+        double zImaginarySquared = zImaginary * zImaginary;
+        zImaginary = 2.0 * zReal * zImaginary + cImaginary;
+        zReal = zRealSquared - zImaginarySquared + cReal;
+
+        double magnitudeSquared = zReal * zReal + zImaginary * zImaginary;
+        if (magnitudeSquared > radiusSquared) {
+            return distanceFromOrbit(magnitudeSquared,
+                                     dzReal * dzReal + dzImaginary * dzImaginary);
+        }
+    }
+    return 0.0;
 }
 
 // Function to map the number of iterations to a color.
 // This is a simple grayscale mapping, but can be extended to full color.
 // 'iterations' is the result from mandelbrotIterations.
 // Returns a simple integer representing intensity (0=black, 255=white).
-int mapIterationsToColor(int iterations) {
-    if (iterations == MAX_ITERATIONS) {
+int mapIterationsToColor(int iterations, int maxIterations = MAX_ITERATIONS) {
+    if (iterations == maxIterations) {
         // Points inside the Mandelbrot set are typically colored black.
         return 0;
     } else {
@@ -71,75 +208,3571 @@ int mapIterationsToColor(int iterations) {
         // We map the iteration count to a grayscale value.
         // A linear mapping is simple: more iterations means brighter color.
         // The division ensures the value stays within 0-255.
-        return static_cast<int>(255 * static_cast<double>(iterations) / MAX_ITERATIONS);
+        return static_cast<int>(255 * static_cast<double>(iterations) / maxIterations);
     }
 }
 
-int main() {
-    // This vector will hold our pixel data. We'll store grayscale intensity.
-    // Imagine this as a 2D array of pixels.
-    std::vector<std::vector<int>> imageData(IMAGE_HEIGHT, std::vector<int>(IMAGE_WIDTH));
+// Maps an estimated boundary distance to a grayscale color.
+// 'pixelSize' is the width of one pixel in the complex plane. Points inside the
+// set (distance 0) are black, points within about a pixel of the boundary are
+// dark and everything further away fades to white. Because this only depends
+// on the distance, filaments thinner than a pixel still show up as dark lines.
+int mapDistanceToColor(double distance, double pixelSize) {
+    double t = std::min(1.0, distance / pixelSize);
+    return static_cast<int>(255 * std::sqrt(t));
+}
+
+// How tiles are ordered before they are handed to the rendering threads.
+enum class Schedule {
+    Uniform,    // Top-left to bottom-right, in image order.
+    Predictive, // Most expensive first, according to a low-resolution probe.
+};
+
+// How the memory of a frame buffer is backed (see FrameBuffer).
+enum class HugePages {
+    Off,         // Ordinary 4 KB pages.
+    Transparent, // Ask the kernel to use 2 MB pages where it can (madvise).
+    Explicit,    // Reserved 2 MB pages (MAP_HUGETLB), Transparent if none are free.
+};
+
+// Everything needed to describe one frame: its size in pixels, the region of
+// the complex plane it shows and the iteration budget per pixel.
+// The defaults are the constants above, so RenderSettings{} is the classic view.
+struct RenderSettings {
+    int width = IMAGE_WIDTH;
+    int height = IMAGE_HEIGHT;
+    double minReal = MIN_REAL;
+    double maxReal = MAX_REAL;
+    double minImaginary = MIN_IMAGINARY;
+    double maxImaginary = MAX_IMAGINARY;
+    int maxIterations = MAX_ITERATIONS;
 
-    // Loop through each pixel in our image.
-    for (int y = 0; y < IMAGE_HEIGHT; ++y) {
-        for (int x = 0; x < IMAGE_WIDTH; ++x) {
-            // 1. Map the pixel coordinates (x, y) to a point in the complex plane.
-            // We scale and shift the pixel coordinates to fit within our defined
-            // MIN/MAX_REAL and MIN/MAX_IMAGINARY ranges.
+    // Copy the rows below the real axis from their mirror images above it
+    // instead of computing them (see findMirrorRows).
+    bool exploitSymmetry = true;
 
-            // Calculate the real part of the complex number.
-            // (x / IMAGE_WIDTH) maps the x-coordinate from [0, IMAGE_WIDTH) to [0.0, 1.0).
-            // Then we scale it by (MAX_REAL - MIN_REAL) and shift it by MIN_REAL.
-            double real = MIN_REAL + (static_cast<double>(x) / IMAGE_WIDTH) * (MAX_REAL - MIN_REAL);
+    // Tile ordering used by the parallel renderer (see scheduleTiles).
+    Schedule schedule = Schedule::Predictive;
 
-            // Calculate the imaginary part of the complex number.
-            // Similarly, we map the y-coordinate from [0, IMAGE_HEIGHT) to [0.0, 1.0).
-            // Note: the y-axis usually increases downwards in images, so we might
-            // need to invert it depending on the complex plane orientation. Here,
-            // we map y=0 to MAX_IMAGINARY and y=IMAGE_HEIGHT to MIN_IMAGINARY
-            // to match the typical view of the Mandelbrot set.
-            double imaginary = MAX_IMAGINARY - (static_cast<double>(y) / IMAGE_HEIGHT) * (MAX_IMAGINARY - MIN_IMAGINARY);
+    // Page size of the frame buffers, and whether each rendering thread is
+    // pinned to a CPU and owns (first touches) one band of the frame so that
+    // its pages live on that thread's NUMA node (see renderFrame).
+    HugePages hugePages = HugePages::Transparent;
+    bool numaPlacement = false;
+
+    // Map the pixel coordinates (x, y) to a point in the complex plane.
+    // We scale and shift the pixel coordinates to fit within the
+    // minReal/maxReal and minImaginary/maxImaginary ranges.
+    double pixelReal(int x) const {
+        // (x / width) maps the x-coordinate from [0, width) to [0.0, 1.0).
+        // Then we scale it by (maxReal - minReal) and shift it by minReal.
+        return minReal + (static_cast<double>(x) / width) * (maxReal - minReal);
+    }
+
+    double pixelImaginary(int y) const {
+        // Note: the y-axis usually increases downwards in images, so we map
+        // y=0 to maxImaginary and y=height to minImaginary to match the
+        // typical view of the Mandelbrot set.
+        return maxImaginary - (static_cast<double>(y) / height) * (maxImaginary - minImaginary);
+    }
+};
+
+// A row kernel computes the iteration counts for pixels [xBegin, xEnd) of row y
+// and stores them in out[0 .. xEnd - xBegin).
+// Working on a run of pixels rather than one pixel at a time lets a kernel
+// reuse the row's imaginary part and keep its inner loop tight.
+using RowKernel = void (*)(const RenderSettings& settings, int y, int xBegin, int xEnd, int* out);
+
+// The original kernel: one std::complex<double> per pixel.
+void complexRowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd, int* out) {
+    double imaginary = settings.pixelImaginary(y);
+    for (int x = xBegin; x < xEnd; ++x) {
+        std::complex<double> c(settings.pixelReal(x), imaginary);
+        out[x - xBegin] = mandelbrotIterations(c, settings.maxIterations);
+    }
+}
 
-            // Create the complex number 'c' for this pixel.
-            std::complex<double> c(real, imaginary);
+// The hand-expanded kernel built on mandelbrotIterationsScalar().
+void scalarRowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd, int* out) {
+    double imaginary = settings.pixelImaginary(y);
+    for (int x = xBegin; x < xEnd; ++x) {
+        out[x - xBegin] = mandelbrotIterationsScalar(settings.pixelReal(x), imaginary,
+                                                     settings.maxIterations);
+    }
+}
 
-            // 2. Calculate how many iterations it takes for 'c' to escape.
-            int iterations = mandelbrotIterations(c);
+// The scalar loop run on SIMD_LANES neighbouring pixels at once.
+// Every lane performs the same arithmetic, so the compiler can keep the lanes
+// in one vector register. A lane that has escaped keeps iterating (its result
+// is already recorded) until all lanes are done, which keeps the loop free of
+// per-lane branches.
+void simdRowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd, int* out) {
+    const int maxIterations = settings.maxIterations;
+    double cImaginary = settings.pixelImaginary(y);
+    for (int x = xBegin; x < xEnd; x += SIMD_LANES) {
+        int lanes = std::min(SIMD_LANES, xEnd - x);
+        double cReal[SIMD_LANES], zReal[SIMD_LANES], zImaginary[SIMD_LANES];
+        int count[SIMD_LANES];
+        for (int l = 0; l < SIMD_LANES; ++l) {
+            // Spare lanes at the end of a row repeat the last pixel.
+            cReal[l] = settings.pixelReal(x + std::min(l, lanes - 1));
+            zReal[l] = zImaginary[l] = 0.0;
+            count[l] = maxIterations;
+        }
 
-            // 3. Map the iteration count to a grayscale color.
-            int color = mapIterationsToColor(iterations);
+        for (int i = 0; i < maxIterations; ++i) {
+            bool allEscaped = true;
+            for (int l = 0; l < SIMD_LANES; ++l) {
+                double zRealSquared = zReal[l] * zReal[l];
+                double zImaginarySquared = zImaginary[l] * zImaginary[l];
+                zImaginary[l] = 2.0 * zReal[l] * zImaginary[l] + cImaginary;
+                zReal[l] = zRealSquared - zImaginarySquared + cReal[l];
+                bool escaped = zReal[l] * zReal[l] + zImaginary[l] * zImaginary[l] > 4.0;
+                count[l] = (escaped && count[l] == maxIterations) ? i : count[l];
+                allEscaped = allEscaped && count[l] != maxIterations;
+            }
+            if (allEscaped) break;
+        }
 
-            // Store the color in our image data.
-            imageData[y][x] = color;
+        for (int l = 0; l < lanes; ++l) {
+            out[x - xBegin + l] = count[l];
         }
     }
+}
 
-    // --- Example Usage: Outputting the image data ---
-    // For a real application, you'd save this data to an image file (like PPM, PNG).
-    // Here, we'll just print a small portion or a simplified representation to the console.
-    // This demonstrates that we have computed the data.
+// --- Fixed-point kernels ---
+// The floating-point kernels can give slightly different iteration counts
+// depending on the compiler, its optimization level and whether it fuses
+// a * b + c into one FMA instruction. Integer arithmetic has no such freedom,
+// so the fixed-point kernels below give bit-identical results on every build.
+//
+// A fixed-point number stores x as the integer round(x * 2^F), where F is the
+// number of fractional bits. Adding two of them is plain integer addition;
+// multiplying needs the high part of the double-width product shifted right
+// by F. We round products toward zero, which keeps the arithmetic symmetric
+// under negation just like the floating-point kernels.
+//
+// The pixel coordinates are computed in fixed point too (the corner plus x
+// times the pixel step), so not even the mapping from pixel to 'c' involves
+// a floating-point operation that the compiler could reorder.
 
-    std::cout << "Mandelbrot set visualization data generated.\n";
-    std::cout << "Image dimensions: " << IMAGE_WIDTH << "x" << IMAGE_HEIGHT << "\n";
-    std::cout << "Max iterations: " << MAX_ITERATIONS << "\n";
-    std::cout << "\nDisplaying a small preview (first 10x10 pixels):\n";
+// fixed64: 64-bit integers with 56 fractional bits, so values in (-128, 128)
+// with a resolution of 2^-56 (about 1.4e-17).
+const int FIXED64_FRACTION_BITS = 56;
 
-    for (int y = 0; y < std::min(10, IMAGE_HEIGHT); ++y) {
-        for (int x = 0; x < std::min(10, IMAGE_WIDTH); ++x) {
-            // Print a character based on the color intensity.
-            // '#' for darker areas, '.' for brighter areas.
-            if (imageData[y][x] < 50) std::cout << "#"; // Darker, likely in or near the set
-            else if (imageData[y][x] < 150) std::cout << "*";
-            else std::cout << "."; // Brighter, escaped quickly
+// fixed128: 128-bit integers with 120 fractional bits (resolution about 7.5e-37).
+const int FIXED128_FRACTION_BITS = 120;
+
+// |z| stays below 2 until it escapes, so one more step gives components of at
+// most 2^2 + |c|: below 128 for views with coordinates up to this limit. Their
+// squares could still overflow the 7 integer bits (they reach 128 once |c| is
+// about 7), so the kernels test each component against 2 before squaring it.
+// A component beyond 2 means |z| > 2, the same escape the squares would find.
+const double FIXED_MAX_COORDINATE = 64.0;
+
+using int128 = __int128;
+using uint128 = unsigned __int128;
+
+// Converts a double to fixed point with 'fractionBits' bits, exactly where possible.
+int64_t toFixed64(double value) {
+    return std::llround(std::ldexp(value, FIXED64_FRACTION_BITS));
+}
+
+int128 toFixed128(double value) {
+    // Split value into a 53-bit integer mantissa and a power of two, then shift.
+    int exponent;
+    double fraction = std::frexp(value, &exponent);
+    int128 mantissa = std::llround(std::ldexp(fraction, 53));
+    int shift = exponent - 53 + FIXED128_FRACTION_BITS;
+    return shift >= 0 ? mantissa * (int128(1) << shift) : mantissa / (int128(1) << -shift);
+}
+
+// (a * b) / 2^56, rounded toward zero. The product of two 64-bit numbers fits
+// in 128 bits; on x86-64 this compiles to a single widening multiply.
+inline int64_t fixedMul64(int64_t a, int64_t b) {
+    int128 product = static_cast<int128>(a) * b;
+    return static_cast<int64_t>(product >= 0 ? product >> FIXED64_FRACTION_BITS
+                                             : -((-product) >> FIXED64_FRACTION_BITS));
+}
+
+// a^2 / 2^56. A square is never negative, so the shift needs no sign fix-up.
+inline int64_t fixedSquare64(int64_t a) {
+    return static_cast<int64_t>((static_cast<int128>(a) * a) >> FIXED64_FRACTION_BITS);
+}
+
+// (a * b) / 2^120, rounded toward zero. The 256-bit product is assembled from
+// four 64 x 64 -> 128-bit partial products of the magnitudes.
+inline int128 fixedMul128(int128 a, int128 b) {
+    bool negative = (a < 0) != (b < 0);
+    uint128 ua = a < 0 ? -static_cast<uint128>(a) : static_cast<uint128>(a);
+    uint128 ub = b < 0 ? -static_cast<uint128>(b) : static_cast<uint128>(b);
+    uint64_t a0 = static_cast<uint64_t>(ua), a1 = static_cast<uint64_t>(ua >> 64);
+    uint64_t b0 = static_cast<uint64_t>(ub), b1 = static_cast<uint64_t>(ub >> 64);
+    uint128 p00 = static_cast<uint128>(a0) * b0;
+    uint128 p01 = static_cast<uint128>(a0) * b1;
+    uint128 p10 = static_cast<uint128>(a1) * b0;
+    uint128 p11 = static_cast<uint128>(a1) * b1;
+    // product = p11 * 2^128 + (p01 + p10) * 2^64 + p00
+    uint128 middle = (p00 >> 64) + static_cast<uint64_t>(p01) + static_cast<uint64_t>(p10);
+    uint128 high = p11 + (p01 >> 64) + (p10 >> 64) + (middle >> 64);
+    uint128 low = (middle << 64) | static_cast<uint64_t>(p00);
+    uint128 result = (high << (128 - FIXED128_FRACTION_BITS)) | (low >> FIXED128_FRACTION_BITS);
+    return negative ? -static_cast<int128>(result) : static_cast<int128>(result);
+}
+
+// The fixed64 kernel, SIMD_LANES pixels at a time like simdRowKernel.
+// x86 has no vector instruction for a 64 x 64 -> 128-bit multiply, so each
+// lane's multiply-high is a scalar MULX/IMUL; keeping the lanes independent
+// still lets the CPU overlap their multiplies.
+void fixed64RowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd, int* out) {
+    const int maxIterations = settings.maxIterations;
+    const int64_t two = int64_t(2) << FIXED64_FRACTION_BITS;
+    const int64_t four = int64_t(4) << FIXED64_FRACTION_BITS;
+    const int64_t stepReal = toFixed64((settings.maxReal - settings.minReal) / settings.width);
+    const int64_t stepImaginary =
+        toFixed64((settings.maxImaginary - settings.minImaginary) / settings.height);
+    const int64_t cImaginary = toFixed64(settings.maxImaginary) - y * stepImaginary;
+    const int64_t minReal = toFixed64(settings.minReal);
+
+    for (int x = xBegin; x < xEnd; x += SIMD_LANES) {
+        int lanes = std::min(SIMD_LANES, xEnd - x);
+        int64_t cReal[SIMD_LANES], zReal[SIMD_LANES], zImaginary[SIMD_LANES];
+        int64_t zRealSquared[SIMD_LANES], zImaginarySquared[SIMD_LANES];
+        int count[SIMD_LANES];
+        for (int l = 0; l < SIMD_LANES; ++l) {
+            cReal[l] = minReal + (x + std::min(l, lanes - 1)) * stepReal;
+            zReal[l] = zImaginary[l] = zRealSquared[l] = zImaginarySquared[l] = 0;
+            count[l] = maxIterations;
+        }
+
+        for (int i = 0; i < maxIterations; ++i) {
+            bool allEscaped = true;
+            for (int l = 0; l < SIMD_LANES; ++l) {
+                if (count[l] != maxIterations) continue; // Escaped lanes would overflow.
+                // The squares from last iteration's escape test are reused.
+                zImaginary[l] = 2 * fixedMul64(zReal[l], zImaginary[l]) + cImaginary;
+                zReal[l] = zRealSquared[l] - zImaginarySquared[l] + cReal[l];
+                if (zReal[l] > two || zReal[l] < -two || zImaginary[l] > two || zImaginary[l] < -two) {
+                    count[l] = i; // Escaped, and squaring could overflow.
+                    continue;
+                }
+                zRealSquared[l] = fixedSquare64(zReal[l]);
+                zImaginarySquared[l] = fixedSquare64(zImaginary[l]);
+                if (zRealSquared[l] + zImaginarySquared[l] > four) {
+                    count[l] = i;
+                } else {
+                    allEscaped = false;
+                }
+            }
+            if (allEscaped) break;
+        }
+
+        for (int l = 0; l < lanes; ++l) {
+            out[x - xBegin + l] = count[l];
         }
-        std::cout << "\n";
     }
-    std::cout << "\n'#' represents points likely inside the Mandelbrot set.\n";
-    std::cout << "'.' represents points that escaped quickly.\n";
+}
 
-    // To actually see the fractal, you would need to write this 'imageData'
-    // to a file format that an image viewer can open, like PPM (Portable Pixmap).
-    // For example, you could add code here to write to a .ppm file.
+// The fixed128 kernel, one pixel at a time. Because the pixel coordinates are
+// exact sums in 120-bit fixed point, neighbouring pixels stay distinct even
+// when the pixel step is far below the resolution of a double near the corner.
+void fixed128RowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd, int* out) {
+    const int128 two = int128(2) << FIXED128_FRACTION_BITS;
+    const int128 four = int128(4) << FIXED128_FRACTION_BITS;
+    const int128 stepReal = toFixed128((settings.maxReal - settings.minReal) / settings.width);
+    const int128 stepImaginary =
+        toFixed128((settings.maxImaginary - settings.minImaginary) / settings.height);
+    const int128 cImaginary = toFixed128(settings.maxImaginary) - y * stepImaginary;
+    const int128 minReal = toFixed128(settings.minReal);
 
-    return 0;
-}
\ No newline at end of file
+    for (int x = xBegin; x < xEnd; ++x) {
+        int128 cReal = minReal + x * stepReal;
+        int128 zReal = 0, zImaginary = 0, zRealSquared = 0, zImaginarySquared = 0;
+        int count = settings.maxIterations;
+        for (int i = 0; i < settings.maxIterations; ++i) {
+            zImaginary = 2 * fixedMul128(zReal, zImaginary) + cImaginary;
+            zReal = zRealSquared - zImaginarySquared + cReal;
+            if (zReal > two || zReal < -two || zImaginary > two || zImaginary < -two) {
+                count = i; // Escaped, and squaring could overflow.
+                break;
+            }
+            zRealSquared = fixedMul128(zReal, zReal);
+            zImaginarySquared = fixedMul128(zImaginary, zImaginary);
+            if (zRealSquared + zImaginarySquared > four) {
+                count = i;
+                break;
+            }
+        }
+        out[x - xBegin] = count;
+    }
+}
+
+// Picks the kernel for a frame when the user asks for "auto": fixed64 while
+// the pixel step is at least 2^-44, leaving 12 bits of headroom for rounding
+// errors to grow during the iteration; fixed128 for deeper zooms; and the
+// floating-point SIMD kernel for views too far out for fixed point.
+RowKernel chooseRowKernel(const RenderSettings& settings) {
+    double largest = std::max({std::abs(settings.minReal), std::abs(settings.maxReal),
+                               std::abs(settings.minImaginary), std::abs(settings.maxImaginary)});
+    if (largest >= FIXED_MAX_COORDINATE) return simdRowKernel;
+    double step = std::min((settings.maxReal - settings.minReal) / settings.width,
+                           (settings.maxImaginary - settings.minImaginary) / settings.height);
+    return step >= std::ldexp(1.0, -(FIXED64_FRACTION_BITS - 12)) ? fixed64RowKernel
+                                                                  : fixed128RowKernel;
+}
+
+void autoRowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd, int* out) {
+    chooseRowKernel(settings)(settings, y, xBegin, xEnd, out);
+}
+
+// A distance row kernel stores the estimated boundary distance of pixels
+// [xBegin, xEnd) of row y in out[0 .. xEnd - xBegin), using 0 for interior points.
+using DistanceRowKernel = void (*)(const RenderSettings& settings, int y, int xBegin, int xEnd,
+                                   double* out);
+
+// Distance estimation with std::complex, mirroring complexRowKernel.
+void complexDistanceRowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd,
+                              double* out) {
+    const double radiusSquared = DISTANCE_ESCAPE_RADIUS * DISTANCE_ESCAPE_RADIUS;
+    double imaginary = settings.pixelImaginary(y);
+    for (int x = xBegin; x < xEnd; ++x) {
+        std::complex<double> c(settings.pixelReal(x), imaginary);
+        std::complex<double> z = 0, dz = 0;
+        double distance = 0.0;
+        for (int i = 0; i < settings.maxIterations; ++i) {
+            dz = 2.0 * z * dz + 1.0;
+            z = z * z + c;
+            if (std::norm(z) > radiusSquared) {
+                distance = distanceFromOrbit(std::norm(z), std::norm(dz));
+                break;
+            }
+        }
+        out[x - xBegin] = distance;
+    }
+}
+
+void scalarDistanceRowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd,
+                             double* out) {
+    double imaginary = settings.pixelImaginary(y);
+    for (int x = xBegin; x < xEnd; ++x) {
+        out[x - xBegin] = mandelbrotDistanceScalar(settings.pixelReal(x), imaginary,
+                                                   settings.maxIterations);
+    }
+}
+
+// mandelbrotDistanceScalar() on SIMD_LANES pixels at once, organised like simdRowKernel.
+// Each lane latches |z|^2 and |dz|^2 on the iteration it escapes; the
+// logarithm and square roots are only taken once per pixel at the end.
+void simdDistanceRowKernel(const RenderSettings& settings, int y, int xBegin, int xEnd,
+                           double* out) {
+    const double radiusSquared = DISTANCE_ESCAPE_RADIUS * DISTANCE_ESCAPE_RADIUS;
+    double cImaginary = settings.pixelImaginary(y);
+    for (int x = xBegin; x < xEnd; x += SIMD_LANES) {
+        int lanes = std::min(SIMD_LANES, xEnd - x);
+        double cReal[SIMD_LANES], zReal[SIMD_LANES], zImaginary[SIMD_LANES];
+        double dzReal[SIMD_LANES], dzImaginary[SIMD_LANES];
+        double escapeZ[SIMD_LANES], escapeDz[SIMD_LANES];
+        bool escaped[SIMD_LANES];
+        for (int l = 0; l < SIMD_LANES; ++l) {
+            cReal[l] = settings.pixelReal(x + std::min(l, lanes - 1));
+            zReal[l] = zImaginary[l] = dzReal[l] = dzImaginary[l] = 0.0;
+            escapeZ[l] = escapeDz[l] = 0.0;
+            escaped[l] = false;
+        }
+
+        for (int i = 0; i < settings.maxIterations; ++i) {
+            bool allEscaped = true;
+            for (int l = 0; l < SIMD_LANES; ++l) {
+                double newDzReal = 2.0 * (zReal[l] * dzReal[l] - zImaginary[l] * dzImaginary[l]) + 1.0;
+                dzImaginary[l] = 2.0 * (zReal[l] * dzImaginary[l] + zImaginary[l] * dzReal[l]);
+                dzReal[l] = newDzReal;
+
+                double zRealSquared = zReal[l] * zReal[l];
+                double zImaginarySquared = zImaginary[l] * zImaginary[l];
+                zImaginary[l] = 2.0 * zReal[l] * zImaginary[l] + cImaginary;
+                zReal[l] = zRealSquared - zImaginarySquared + cReal[l];
+
+                double magnitudeSquared = zReal[l] * zReal[l] + zImaginary[l] * zImaginary[l];
+                bool escapesNow = !escaped[l] && magnitudeSquared > radiusSquared;
+                escapeZ[l] = escapesNow ? magnitudeSquared : escapeZ[l];
+                escapeDz[l] = escapesNow ? dzReal[l] * dzReal[l] + dzImaginary[l] * dzImaginary[l]
+                                         : escapeDz[l];
+                escaped[l] = escaped[l] || escapesNow;
+                allEscaped = allEscaped && escaped[l];
+            }
+            if (allEscaped) break;
+        }
+
+        for (int l = 0; l < lanes; ++l) {
+            out[x - xBegin + l] = escaped[l] ? distanceFromOrbit(escapeZ[l], escapeDz[l]) : 0.0;
+        }
+    }
+}
+
+// A named kernel, so it can be picked on the command line and benchmarked.
+// Each kernel comes with an escape-time and a distance-estimation variant.
+// The derivative dz grows far beyond the range of fixed point, so the
+// fixed-point kernels (and "auto") estimate distances in floating point.
+struct Kernel {
+    const char* name;
+    RowKernel renderRow;
+    DistanceRowKernel renderDistanceRow;
+};
+
+// Every kernel the renderer knows about. The first entry is the default.
+const Kernel KERNELS[] = {
+    {"auto", autoRowKernel, simdDistanceRowKernel},
+    {"complex", complexRowKernel, complexDistanceRowKernel},
+    {"scalar", scalarRowKernel, scalarDistanceRowKernel},
+    {"simd", simdRowKernel, simdDistanceRowKernel},
+    {"fixed64", fixed64RowKernel, simdDistanceRowKernel},
+    {"fixed128", fixed128RowKernel, scalarDistanceRowKernel},
+};
+
+// Looks a kernel up by name. Returns nullptr if there is no such kernel.
+const Kernel* findKernel(const std::string& name) {
+    for (const Kernel& kernel : KERNELS) {
+        if (name == kernel.name) return &kernel;
+    }
+    return nullptr;
+}
+
+// A rectangle of pixels [x0, x1) x [y0, y1).
+struct Tile {
+    int x0, y0, x1, y1;
+};
+
+// Splits the image into tiles of at most tileSize x tileSize pixels,
+// row by row from the top-left corner.
+std::vector<Tile> makeTiles(const RenderSettings& settings, int tileSize) {
+    std::vector<Tile> tiles;
+    for (int y = 0; y < settings.height; y += tileSize) {
+        for (int x = 0; x < settings.width; x += tileSize) {
+            tiles.push_back({x, y, std::min(x + tileSize, settings.width),
+                             std::min(y + tileSize, settings.height)});
+        }
+    }
+    return tiles;
+}
+
+// --- Frame buffers and NUMA placement ---
+//
+// A gigapixel frame is far larger than any cache, so two things about its
+// memory matter: how many TLB entries it takes to reach it, and which NUMA
+// node (which socket's memory) each page lives on. FrameBuffer maps the frame
+// with 2 MB pages when possible, and leaves the pages untouched so that each
+// one is placed on the node of the thread that writes to it first.
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// A contiguous, row-major pixel buffer allocated straight from mmap.
+// Unlike std::vector it does not write the elements when it is allocated
+// (mmap pages read as zero until they are written), so the rendering threads
+// get to touch every page first.
+template <class T>
+class FrameBuffer {
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "pixels are raw memory");
+
+    FrameBuffer() = default;
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+    ~FrameBuffer() { release(); }
+
+    // Makes room for 'count' elements. An existing mapping is reused when it
+    // is large enough, so rendering many frames of one size allocates once;
+    // its contents are then left over from the previous frame.
+    void allocate(size_t count, HugePages hugePages) {
+        size_ = count;
+        if (count * sizeof(T) <= bytes_ && hugePages == requested_) return;
+        release();
+        requested_ = hugePages;
+        backing_ = hugePages;
+        bytes_ = std::max<size_t>(1, count * sizeof(T));
+        if (hugePages != HugePages::Off) {
+            bytes_ = (bytes_ + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        }
+
+        void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (hugePages == HugePages::Explicit) {
+            memory = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+#endif
+        if (memory == MAP_FAILED) {
+            // No reserved huge pages (or none left): fall back to normal pages.
+            if (backing_ == HugePages::Explicit) backing_ = HugePages::Transparent;
+            memory = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1, 0);
+            if (memory == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+            if (backing_ == HugePages::Transparent &&
+                madvise(memory, bytes_, MADV_HUGEPAGE) != 0) {
+                backing_ = HugePages::Off;
+            }
+#else
+            backing_ = HugePages::Off;
+#endif
+        }
+        data_ = static_cast<T*>(memory);
+    }
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    size_t size() const { return size_; }
+    T* begin() { return data_; }
+    T* end() { return data_ + size_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    // The page size actually obtained, which may be smaller than requested.
+    HugePages backing() const { return backing_; }
+
+private:
+    void release() {
+        if (data_) munmap(data_, bytes_);
+        data_ = nullptr;
+        bytes_ = 0;
+    }
+
+    T* data_ = nullptr;
+    size_t size_ = 0;
+    size_t bytes_ = 0;
+    HugePages requested_ = HugePages::Off;
+    HugePages backing_ = HugePages::Off;
+};
+
+// Parses a Linux CPU list such as "0-3,8-11" into CPU numbers.
+std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream list(text);
+    std::string range;
+    while (std::getline(list, range, ',')) {
+        int first = 0;
+        int last = 0;
+        int fields = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (fields < 1) continue;
+        if (fields == 1) last = first;
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Returns the CPUs this process may run on, grouped by NUMA node, as listed in
+// /sys/devices/system/node. Without that directory (not Linux, or a kernel
+// without NUMA) all CPUs are reported as a single node.
+std::vector<std::vector<int>> numaNodeCpus() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return {};
+
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file) break;
+        std::string text;
+        std::getline(file, text);
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(text)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+        }
+        if (!cpus.empty()) nodes.push_back(cpus);
+    }
+    if (nodes.empty()) {
+        nodes.emplace_back();
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) nodes.back().push_back(cpu);
+        }
+    }
+    return nodes;
+}
+
+// Picks a CPU for each of numThreads rendering threads. Threads are spread
+// over the nodes in proportion to their CPU counts and consecutive threads
+// share a node, so the consecutive bands they own (see renderFrame) form one
+// contiguous block of memory per node.
+std::vector<int> placeWorkers(int numThreads) {
+    std::vector<int> cpus;
+    for (const std::vector<int>& node : numaNodeCpus()) {
+        cpus.insert(cpus.end(), node.begin(), node.end());
+    }
+    std::vector<int> placement;
+    if (cpus.empty()) return placement;
+    for (int t = 0; t < numThreads; ++t) {
+        placement.push_back(cpus[static_cast<size_t>(t) * cpus.size() / numThreads]);
+    }
+    return placement;
+}
+
+// Restricts the calling thread to one CPU. Returns false if that is not allowed.
+bool pinThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Calls body(workerId) once on each of numThreads threads. The calling thread
+// is worker 0. If 'cpus' is given, worker t runs pinned to CPU cpus[t]; the
+// calling thread gets its old CPU mask back afterwards.
+template <class Body>
+void runWorkers(int numThreads, const std::vector<int>* cpus, Body body) {
+    cpu_set_t callerMask;
+    bool restoreCaller = cpus && pthread_getaffinity_np(pthread_self(), sizeof(callerMask),
+                                                        &callerMask) == 0;
+    auto work = [&](int workerId) {
+        if (cpus) pinThread((*cpus)[workerId]);
+        body(workerId);
+    };
+
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < numThreads; ++t) {
+        helpers.emplace_back(work, t);
+    }
+    work(0);
+    for (std::thread& helper : helpers) {
+        helper.join();
+    }
+    if (restoreCaller) pthread_setaffinity_np(pthread_self(), sizeof(callerMask), &callerMask);
+}
+
+// Calls body(index, workerId) for every index in [0, count) using numThreads threads.
+// Indices are handed out one at a time from a shared atomic counter, so a thread
+// that finishes a cheap tile immediately picks up the next one instead of
+// waiting for a fixed share of the image. The calling thread is worker 0.
+template <class Body>
+void parallelFor(int count, int numThreads, Body body) {
+    std::atomic<int> next(0);
+    runWorkers(std::max(1, std::min(numThreads, count)), nullptr, [&](int workerId) {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            body(i, workerId);
+        }
+    });
+}
+
+// The Mandelbrot set is symmetric about the real axis: the orbit of conj(c)
+// is the mirror image of the orbit of c, so both escape on the same iteration
+// and have the same boundary distance. When the view spans the real axis, the
+// rows on one side can be copied from the other instead of being computed.
+//
+// Returns, for every row, the row it can be copied from, or -1 if the row has
+// to be rendered. A row below the axis is only paired with a row above it when
+// the two line up with the pixel grid, i.e. their imaginary parts cancel to
+// within a millionth of a pixel (the leftover is floating-point rounding in
+// pixelImaginary). If the axis falls between pixel rows at an odd offset,
+// nothing lines up and every row is rendered.
+std::vector<int> findMirrorRows(const RenderSettings& settings) {
+    std::vector<int> mirror(settings.height, -1);
+    if (!settings.exploitSymmetry) return mirror;
+
+    double pixelHeight = (settings.maxImaginary - settings.minImaginary) / settings.height;
+    for (int y = 0; y < settings.height; ++y) {
+        double imaginary = settings.pixelImaginary(y);
+        if (imaginary >= 0.0) continue;
+
+        // Solve pixelImaginary(source) == -imaginary for the source row.
+        double exactSource = (settings.maxImaginary + imaginary) / pixelHeight;
+        long long source = std::llround(exactSource);
+        if (source < 0 || source >= settings.height || source == y) continue;
+        if (std::abs(settings.pixelImaginary(static_cast<int>(source)) + imaginary) <=
+            1e-6 * pixelHeight) {
+            mirror[y] = static_cast<int>(source);
+        }
+    }
+    return mirror;
+}
+
+// The number of times the loop body of z = z^2 + c actually ran for a pixel.
+// An escaping pixel reports the index of the iteration it escaped on, so it
+// ran one more time than its count; an interior pixel ran maxIterations times.
+long long iterationsExecuted(int iterations, int maxIterations) {
+    return iterations < maxIterations ? iterations + 1 : maxIterations;
+}
+
+// Predictive scheduling. Interior tiles run every pixel to maxIterations while
+// exterior tiles finish almost immediately, so a tile can easily cost 100x
+// another. If an expensive tile happens to be handed out last, one thread is
+// still grinding through it while every other core sits idle.
+//
+// To avoid that long tail we first run a cheap probe: the scalar kernel on
+// every PROBE_STRIDE-th pixel of every PROBE_STRIDE-th row. A tile's predicted
+// cost is the number of iterations its probe points ran (plus one per point
+// for the per-pixel overhead). Tiles that would be too big a share of one
+// thread's work are split into quarters, and then everything is sorted most
+// expensive first: the classic "longest processing time first" rule, which
+// leaves only cheap tiles for the end of the frame.
+//
+// Rows in 'mirror' that are copied rather than computed cost nothing.
+void scheduleTiles(const RenderSettings& settings, const std::vector<int>& mirror, int numThreads,
+                   std::vector<Tile>& tiles) {
+    if (settings.schedule != Schedule::Predictive || numThreads <= 1) return;
+
+    // 1. The probe: one low-resolution frame, rendered in parallel by rows.
+    const int probeWidth = (settings.width + PROBE_STRIDE - 1) / PROBE_STRIDE;
+    const int probeHeight = (settings.height + PROBE_STRIDE - 1) / PROBE_STRIDE;
+    std::vector<long long> probe(static_cast<size_t>(probeWidth) * probeHeight, 0);
+    parallelFor(probeHeight, numThreads, [&](int py, int) {
+        int y = py * PROBE_STRIDE;
+        if (mirror[y] >= 0) return;
+        double imaginary = settings.pixelImaginary(y);
+        for (int px = 0; px < probeWidth; ++px) {
+            int count = mandelbrotIterationsScalar(settings.pixelReal(px * PROBE_STRIDE), imaginary,
+                                                   settings.maxIterations);
+            probe[static_cast<size_t>(py) * probeWidth + px] =
+                1 + iterationsExecuted(count, settings.maxIterations);
+        }
+    });
+
+    // Sums the probe points that fall inside a tile.
+    auto predictCost = [&](const Tile& tile) {
+        long long cost = 0;
+        for (int py = (tile.y0 + PROBE_STRIDE - 1) / PROBE_STRIDE; py * PROBE_STRIDE < tile.y1; ++py) {
+            for (int px = (tile.x0 + PROBE_STRIDE - 1) / PROBE_STRIDE; px * PROBE_STRIDE < tile.x1; ++px) {
+                cost += probe[static_cast<size_t>(py) * probeWidth + px];
+            }
+        }
+        return cost;
+    };
+
+    // 2. Split tiles that are too large a share of one thread's work.
+    std::vector<std::pair<long long, Tile>> costed;
+    long long total = 0;
+    for (const Tile& tile : tiles) {
+        costed.emplace_back(predictCost(tile), tile);
+        total += costed.back().first;
+    }
+    const long long splitAbove = total / (static_cast<long long>(numThreads) * TILE_SPLIT_SHARE);
+    for (size_t i = 0; i < costed.size(); ++i) {
+        Tile tile = costed[i].second;
+        if (costed[i].first <= splitAbove || tile.x1 - tile.x0 < 2 * MIN_SPLIT_TILE_SIZE ||
+            tile.y1 - tile.y0 < 2 * MIN_SPLIT_TILE_SIZE) {
+            continue;
+        }
+        int xMid = (tile.x0 + tile.x1) / 2;
+        int yMid = (tile.y0 + tile.y1) / 2;
+        Tile quarters[4] = {{tile.x0, tile.y0, xMid, yMid}, {xMid, tile.y0, tile.x1, yMid},
+                            {tile.x0, yMid, xMid, tile.y1}, {xMid, yMid, tile.x1, tile.y1}};
+        costed[i] = {predictCost(quarters[0]), quarters[0]};
+        for (int q = 1; q < 4; ++q) costed.emplace_back(predictCost(quarters[q]), quarters[q]);
+        --i; // Look at the first quarter again; it may need splitting too.
+    }
+
+    // 3. Most expensive first.
+    std::stable_sort(costed.begin(), costed.end(),
+                     [](const std::pair<long long, Tile>& a, const std::pair<long long, Tile>& b) {
+                         return a.first > b.first;
+                     });
+    tiles.clear();
+    for (const auto& entry : costed) tiles.push_back(entry.second);
+}
+
+// Cost counters for one rendered tile, collected when instrumentation is on.
+// Only rows that were actually computed count; mirrored rows are free.
+struct TileStats {
+    Tile tile;
+    long long pixels = 0;      // Pixels computed in this tile.
+    long long iterations = 0;  // Iterations of z = z^2 + c executed (escape-time mode only).
+    long long escapes = 0;     // Pixels whose orbit escaped.
+    long long interior = 0;    // Pixels that never escaped.
+    long long wallNs = 0;      // Time the worker spent on the tile.
+    int worker = 0;            // Which thread rendered it (0 is the calling thread).
+};
+
+// Finished tiles are made durable in batches: after this many tiles, or this
+// many seconds since the last batch, whichever comes first. Each batch costs
+// one write and one fsync.
+const int CHECKPOINT_BATCH_TILES = 32;
+const double CHECKPOINT_INTERVAL_SECONDS = 5.0;
+
+const char CHECKPOINT_MAGIC[8] = {'M', 'A', 'N', 'D', 'C', 'K', 'P', 'T'};
+const uint32_t CHECKPOINT_VERSION = 1;
+const uint32_t CHECKPOINT_TILE_MAGIC = 0x454c4954; // "TILE"
+
+// One finished tile in a checkpoint file. The tile's pixels follow it, row by
+// row, sizeof(T) bytes each; 'crc' covers x0..y1 and the pixels.
+struct CheckpointRecord {
+    uint32_t magic;
+    int32_t x0, y0, x1, y1;
+    uint32_t crc;
+};
+
+// An append-only log of finished tiles, so that a long render that is killed
+// can resume where it stopped. The file starts with a header naming the
+// render (size, view, kernel, ...); a checkpoint for any other render is
+// refused. Records are only appended, and a record that was cut short by a
+// crash fails its CRC, so everything before it is still good.
+//
+// Progress is kept per tile: a tile that was being rendered when the process
+// died is rendered again from scratch.
+class Checkpoint {
+public:
+    Checkpoint() = default;
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+    ~Checkpoint() {
+        if (fd_ >= 0) close(fd_);
+    }
+
+    // Opens 'path', or creates it if it does not exist. 'signature'
+    // describes the render; it must match the one in an existing file.
+    bool open(const std::string& path, const std::string& signature) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) return fail("cannot open file");
+        std::string header(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        uint32_t fields[2] = {CHECKPOINT_VERSION, static_cast<uint32_t>(signature.size())};
+        header.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+        header += signature;
+
+        off_t size = lseek(fd_, 0, SEEK_END);
+        if (size == 0) {
+            if (pwrite(fd_, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size()) ||
+                fsync(fd_) != 0) {
+                return fail("cannot write header");
+            }
+            end_ = header.size();
+            return true;
+        }
+        std::string existing(header.size(), '\0');
+        if (size < static_cast<off_t>(header.size()) ||
+            pread(fd_, &existing[0], existing.size(), 0) != static_cast<ssize_t>(existing.size()) ||
+            existing != header) {
+            return fail("checkpoint belongs to a different render");
+        }
+        end_ = header.size();
+        return true;
+    }
+
+    const char* error() const { return error_; }
+    int restoredTiles() const { return restoredTiles_; }
+
+    // Copies every intact tile of the file into 'pixels' (row-major, 'width'
+    // wide) and marks its pixels in 'done'. The file is cut after the last
+    // intact record, so a torn record at the end is overwritten by new ones.
+    template <class T>
+    void restore(T* pixels, size_t width, std::vector<unsigned char>& done) {
+        std::vector<unsigned char> payload;
+        for (;;) {
+            CheckpointRecord record;
+            if (pread(fd_, &record, sizeof(record), end_) != static_cast<ssize_t>(sizeof(record)) ||
+                record.magic != CHECKPOINT_TILE_MAGIC || record.x0 < 0 || record.y0 < 0 ||
+                record.x1 <= record.x0 || record.y1 <= record.y0 ||
+                static_cast<size_t>(record.x1) > width ||
+                static_cast<size_t>(record.y1) * width > done.size()) {
+                break;
+            }
+            size_t rowBytes = (record.x1 - record.x0) * sizeof(T);
+            payload.resize(rowBytes * (record.y1 - record.y0));
+            if (pread(fd_, payload.data(), payload.size(), end_ + sizeof(record)) !=
+                    static_cast<ssize_t>(payload.size()) ||
+                recordCrc(record, payload.data(), payload.size()) != record.crc) {
+                break;
+            }
+            for (int y = record.y0; y < record.y1; ++y) {
+                std::memcpy(pixels + y * width + record.x0,
+                            payload.data() + (y - record.y0) * rowBytes, rowBytes);
+                std::fill(done.begin() + y * width + record.x0, done.begin() + y * width + record.x1, 1);
+            }
+            end_ += sizeof(record) + payload.size();
+            ++restoredTiles_;
+        }
+        if (ftruncate(fd_, static_cast<off_t>(end_)) != 0) fail("cannot truncate file");
+        lastSync_ = std::chrono::steady_clock::now();
+    }
+
+    // Queues a finished tile and, if a batch is due, writes and syncs it.
+    // Safe to call from several threads.
+    template <class T>
+    void save(const Tile& tile, const T* pixels, size_t width) {
+        CheckpointRecord record = {CHECKPOINT_TILE_MAGIC, tile.x0, tile.y0, tile.x1, tile.y1, 0};
+        size_t rowBytes = (tile.x1 - tile.x0) * sizeof(T);
+        std::string bytes(sizeof(record) + rowBytes * (tile.y1 - tile.y0), '\0');
+        for (int y = tile.y0; y < tile.y1; ++y) {
+            std::memcpy(&bytes[sizeof(record) + (y - tile.y0) * rowBytes],
+                        pixels + y * width + tile.x0, rowBytes);
+        }
+        record.crc = recordCrc(record, &bytes[sizeof(record)], bytes.size() - sizeof(record));
+        std::memcpy(&bytes[0], &record, sizeof(record));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ += bytes;
+        ++pendingTiles_;
+        double sinceSync =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - lastSync_).count();
+        if (pendingTiles_ >= CHECKPOINT_BATCH_TILES || sinceSync >= CHECKPOINT_INTERVAL_SECONDS) {
+            flushLocked();
+        }
+    }
+
+    // Writes and syncs whatever is still queued. Returns false if any write failed.
+    bool finish() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flushLocked();
+        return !failed_;
+    }
+
+private:
+    static uint32_t recordCrc(const CheckpointRecord& record, const void* payload, size_t size) {
+        uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(&record.x0), 4 * sizeof(int32_t));
+        return static_cast<uint32_t>(
+            crc32(crc, static_cast<const Bytef*>(payload), static_cast<uInt>(size)));
+    }
+
+    void flushLocked() {
+        if (!pending_.empty()) {
+            if (pwrite(fd_, pending_.data(), pending_.size(), end_) !=
+                    static_cast<ssize_t>(pending_.size()) ||
+                fsync(fd_) != 0) {
+                failed_ = true;
+            } else {
+                end_ += pending_.size();
+            }
+        }
+        pending_.clear();
+        pendingTiles_ = 0;
+        lastSync_ = std::chrono::steady_clock::now();
+    }
+
+    bool fail(const char* reason) {
+        error_ = reason;
+        failed_ = true;
+        return false;
+    }
+
+    int fd_ = -1;
+    size_t end_ = 0;  // Where the next record goes.
+    std::mutex mutex_;
+    std::string pending_;
+    int pendingTiles_ = 0;
+    int restoredTiles_ = 0;
+    std::chrono::steady_clock::time_point lastSync_ = std::chrono::steady_clock::now();
+    bool failed_ = false;
+    const char* error_ = "";
+};
+
+// Splits 'height' rows of rowBytes bytes each into numThreads bands of about
+// equal size and returns the first row of each band, plus 'height' at the end.
+// Band edges are moved to the first row that starts on a new huge page, so
+// that few pages are shared by two bands.
+std::vector<int> frameBands(int height, size_t rowBytes, int numThreads) {
+    const size_t totalBytes = rowBytes * height;
+    std::vector<int> bandStart(numThreads + 1, height);
+    bandStart[0] = 0;
+    for (int t = 1; t < numThreads; ++t) {
+        size_t edge = totalBytes * t / numThreads;
+        edge = (edge + HUGE_PAGE_SIZE / 2) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        size_t row = (edge + rowBytes - 1) / rowBytes;
+        bandStart[t] = static_cast<int>(std::min<size_t>(row, height));
+        bandStart[t] = std::max(bandStart[t], bandStart[t - 1]);
+    }
+    return bandStart;
+}
+
+// Renders a whole frame into 'pixels' (row-major, settings.width entries per
+// row, allocated to fit). renderRow(y, xBegin, xEnd, out) fills one run of a row.
+// Mirrored rows are skipped while the tiles are rendered in parallel and
+// copied from their source rows afterwards.
+//
+// If 'stats' is not null it receives one TileStats per rendered tile. The
+// worker times the tile and then calls tally(pixel, stats) on each freshly
+// computed pixel while it is still in cache. Without 'stats' none of this runs.
+//
+// If 'checkpoint' is not null, tiles it already holds are restored instead of
+// rendered, and every finished tile is appended to it.
+template <class T, class RenderRow, class Tally>
+void renderFrame(const RenderSettings& settings, int numThreads, FrameBuffer<T>& pixels,
+                 RenderRow renderRow, std::vector<TileStats>* stats, Tally tally,
+                 Checkpoint* checkpoint = nullptr) {
+    const size_t width = settings.width;
+    pixels.allocate(width * settings.height, settings.hugePages);
+    std::vector<int> mirror = findMirrorRows(settings);
+
+    // Tiles whose rows are all mirrored have nothing left to compute.
+    std::vector<Tile> tiles = makeTiles(settings, TILE_SIZE);
+    tiles.erase(std::remove_if(tiles.begin(), tiles.end(),
+                               [&](const Tile& tile) {
+                                   for (int y = tile.y0; y < tile.y1; ++y) {
+                                       if (mirror[y] < 0) return false;
+                                   }
+                                   return true;
+                               }),
+                tiles.end());
+
+    // Tiles saved by an earlier, interrupted run are copied back instead of
+    // rendered. A tile only partly covered by saved tiles (the earlier run
+    // may have split it differently) is rendered again. They are restored
+    // into a separate buffer and copied into the frame just before rendering,
+    // so that with NUMA placement the copy is each band's first touch.
+    std::vector<T> restored;
+    if (checkpoint) {
+        std::vector<unsigned char> done(pixels.size(), 0);
+        restored.assign(pixels.size(), T());
+        checkpoint->restore(restored.data(), width, done);
+        tiles.erase(std::remove_if(tiles.begin(), tiles.end(),
+                                   [&](const Tile& tile) {
+                                       for (int y = tile.y0; y < tile.y1; ++y) {
+                                           if (mirror[y] >= 0) continue;
+                                           for (int x = tile.x0; x < tile.x1; ++x) {
+                                               if (!done[y * width + x]) return false;
+                                           }
+                                       }
+                                       return true;
+                                   }),
+                    tiles.end());
+    }
+    scheduleTiles(settings, mirror, numThreads, tiles);
+
+    if (stats) stats->assign(tiles.size(), TileStats());
+    auto renderTile = [&](int index, int workerId) {
+        const Tile& tile = tiles[index];
+        auto start = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        for (int y = tile.y0; y < tile.y1; ++y) {
+            if (mirror[y] >= 0) continue;
+            renderRow(y, tile.x0, tile.x1, pixels.data() + y * width + tile.x0);
+        }
+        if (checkpoint) checkpoint->save(tile, pixels.data(), width);
+        if (!stats) return;
+
+        TileStats& tileStats = (*stats)[index];
+        tileStats.wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count();
+        tileStats.tile = tile;
+        tileStats.worker = workerId;
+        for (int y = tile.y0; y < tile.y1; ++y) {
+            if (mirror[y] >= 0) continue;
+            for (int x = tile.x0; x < tile.x1; ++x) {
+                ++tileStats.pixels;
+                tally(pixels[y * width + x], tileStats);
+            }
+        }
+    };
+
+    std::vector<int> cpus;
+    if (settings.numaPlacement && numThreads > 1) cpus = placeWorkers(numThreads);
+    if (cpus.empty()) {
+        if (!restored.empty()) std::copy(restored.begin(), restored.end(), pixels.begin());
+        parallelFor(static_cast<int>(tiles.size()), numThreads, renderTile);
+    } else {
+        // Each pinned thread owns a band of rows, cut on page boundaries. It
+        // first touches the band's pages (clearing them, or copying in the
+        // restored tiles), which places them on its own node, then renders
+        // the band's tiles (in scheduled order) and only then helps with the
+        // other bands.
+        std::vector<int> bandStart = frameBands(settings.height, width * sizeof(T), numThreads);
+        std::vector<std::vector<int>> owned(numThreads);
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            int owner = static_cast<int>(std::upper_bound(bandStart.begin(), bandStart.end(),
+                                                          tiles[i].y0) - bandStart.begin()) - 1;
+            owned[owner].push_back(static_cast<int>(i));
+        }
+        std::vector<std::atomic<size_t>> next(numThreads);
+        for (std::atomic<size_t>& cursor : next) cursor = 0;
+        std::atomic<int> touched(0);
+
+        runWorkers(numThreads, &cpus, [&](int workerId) {
+            size_t begin = bandStart[workerId] * width;
+            size_t end = bandStart[workerId + 1] * width;
+            if (!restored.empty()) {
+                std::copy(restored.begin() + begin, restored.begin() + end, pixels.begin() + begin);
+            } else if (end > begin) {
+                std::memset(pixels.data() + begin, 0, (end - begin) * sizeof(T));
+            }
+            // Wait until every band is placed before anyone starts stealing.
+            touched.fetch_add(1);
+            while (touched.load() < numThreads) std::this_thread::yield();
+
+            for (int k = 0; k < numThreads; ++k) {
+                int band = (workerId + k) % numThreads;
+                for (size_t i = next[band].fetch_add(1); i < owned[band].size();
+                     i = next[band].fetch_add(1)) {
+                    renderTile(owned[band][i], workerId);
+                }
+            }
+        });
+    }
+
+    for (int y = 0; y < settings.height; ++y) {
+        if (mirror[y] < 0) continue;
+        std::copy(pixels.begin() + mirror[y] * width, pixels.begin() + (mirror[y] + 1) * width,
+                  pixels.begin() + y * width);
+    }
+}
+
+// Computes the iteration count of every pixel of the frame.
+// The result is stored row-major in 'iterations', which is allocated to fit.
+// Pass 'stats' to collect per-tile cost counters, and 'checkpoint' to resume
+// from and save to a checkpoint file.
+void renderIterations(const RenderSettings& settings, const Kernel& kernel, int numThreads,
+                      FrameBuffer<int>& iterations, std::vector<TileStats>* stats = nullptr,
+                      Checkpoint* checkpoint = nullptr) {
+    renderFrame(
+        settings, numThreads, iterations,
+        [&](int y, int xBegin, int xEnd, int* out) {
+            kernel.renderRow(settings, y, xBegin, xEnd, out);
+        },
+        stats,
+        [&](int count, TileStats& tileStats) {
+            tileStats.iterations += iterationsExecuted(count, settings.maxIterations);
+            if (count < settings.maxIterations) {
+                ++tileStats.escapes;
+            } else {
+                ++tileStats.interior;
+            }
+        },
+        checkpoint);
+}
+
+// Computes the estimated boundary distance of every pixel of the frame.
+// The result is stored row-major in 'distances', which is allocated to fit.
+// Pass 'stats' to collect per-tile cost counters (the distance kernels do not
+// report iteration counts, so TileStats::iterations stays 0) and 'checkpoint'
+// to resume from and save to a checkpoint file.
+void renderDistances(const RenderSettings& settings, const Kernel& kernel, int numThreads,
+                     FrameBuffer<double>& distances, std::vector<TileStats>* stats = nullptr,
+                     Checkpoint* checkpoint = nullptr) {
+    renderFrame(
+        settings, numThreads, distances,
+        [&](int y, int xBegin, int xEnd, double* out) {
+            kernel.renderDistanceRow(settings, y, xBegin, xEnd, out);
+        },
+        stats,
+        [](double distance, TileStats& tileStats) {
+            if (distance > 0.0) {
+                ++tileStats.escapes;
+            } else {
+                ++tileStats.interior;
+            }
+        },
+        checkpoint);
+}
+
+// Extra iterations run after a pixel escapes, before its fractional escape
+// count is measured. log|z| roughly doubles per iteration once z is large, so
+// a few more steps make the estimate smooth across iteration bands.
+const int SMOOTH_EXTRA_ITERATIONS = 3;
+
+// An iteration count plus the correction that makes it continuous (see
+// renderSmoothIterations).
+struct SmoothPixel {
+    int count;
+    float fraction;
+};
+
+// Computes the iteration count of every pixel, like renderIterations, and
+// also a fractional correction: count + fraction is a continuous escape count
+// that changes smoothly across the iteration bands. The fraction is mostly
+// between -0.5 and 1, larger where the orbit lingers near the escape radius
+// before it takes off, and 0 for interior points. The fraction needs the
+// final value of z, which the row kernels do not return, so this always
+// iterates in double precision like the "scalar" kernel and gives the same
+// counts as that kernel.
+void renderSmoothIterations(const RenderSettings& settings, int numThreads,
+                            FrameBuffer<int>& iterations, FrameBuffer<float>& fractions,
+                            std::vector<TileStats>* stats = nullptr) {
+    FrameBuffer<SmoothPixel> pixels;
+    renderFrame(
+        settings, numThreads, pixels,
+        [&](int y, int xBegin, int xEnd, SmoothPixel* out) {
+            double cImaginary = settings.pixelImaginary(y);
+            for (int x = xBegin; x < xEnd; ++x) {
+                double cReal = settings.pixelReal(x);
+                double zReal = 0.0;
+                double zImaginary = 0.0;
+                SmoothPixel pixel = {settings.maxIterations, 0.0f};
+                for (int i = 0; i < settings.maxIterations + SMOOTH_EXTRA_ITERATIONS; ++i) {
+                    double zRealSquared = zReal * zReal;
+                    double zImaginarySquared = zImaginary * zImaginary;
+                    zImaginary = 2.0 * zReal * zImaginary + cImaginary;
+                    zReal = zRealSquared - zImaginarySquared + cReal;
+                    if (pixel.count == settings.maxIterations) {
+                        if (i == settings.maxIterations) break;
+                        if (zReal * zReal + zImaginary * zImaginary > 4.0) pixel.count = i;
+                    } else if (i == pixel.count + SMOOTH_EXTRA_ITERATIONS) {
+                        double log2Modulus = 0.5 * std::log2(zReal * zReal + zImaginary * zImaginary);
+                        double fraction = 1.0 + SMOOTH_EXTRA_ITERATIONS - std::log2(log2Modulus);
+                        pixel.fraction = static_cast<float>(fraction);
+                        break;
+                    }
+                }
+                out[x - xBegin] = pixel;
+            }
+        },
+        stats,
+        [&](const SmoothPixel& pixel, TileStats& tileStats) {
+            tileStats.iterations += iterationsExecuted(pixel.count, settings.maxIterations);
+            if (pixel.count < settings.maxIterations) {
+                ++tileStats.escapes;
+            } else {
+                ++tileStats.interior;
+            }
+        });
+
+    iterations.allocate(pixels.size(), settings.hugePages);
+    fractions.allocate(pixels.size(), settings.hugePages);
+    parallelFor(settings.height, numThreads, [&](int y, int) {
+        for (size_t i = static_cast<size_t>(y) * settings.width;
+             i < static_cast<size_t>(y + 1) * settings.width; ++i) {
+            iterations[i] = pixels[i].count;
+            fractions[i] = pixels[i].fraction;
+        }
+    });
+}
+
+// Converts a rendered frame to gray levels with color(value), writing 'image'
+// (allocated to fit). The rows are split into the same bands as in
+// renderFrame, so with NUMA placement each thread reads pages it rendered and
+// first touches the image pages it writes.
+template <class T, class Color>
+void mapToImage(const RenderSettings& settings, int numThreads, const FrameBuffer<T>& values,
+                FrameBuffer<unsigned char>& image, Color color) {
+    const size_t width = settings.width;
+    image.allocate(width * settings.height, settings.hugePages);
+    std::vector<int> cpus;
+    if (settings.numaPlacement && numThreads > 1) cpus = placeWorkers(numThreads);
+    std::vector<int> bandStart = frameBands(settings.height, width * sizeof(T), numThreads);
+    runWorkers(numThreads, cpus.empty() ? nullptr : &cpus, [&](int workerId) {
+        for (size_t i = bandStart[workerId] * width; i < bandStart[workerId + 1] * width; ++i) {
+            image[i] = static_cast<unsigned char>(color(values[i]));
+        }
+    });
+}
+
+// --- Quadtree adaptive refinement ---
+// An interactive explorer wants a good-looking frame fast, not every pixel
+// computed. Most of the picture is flat (large bands of equal count, or the
+// black interior); the detail sits near the boundary. The quadtree renderer
+// starts from a coarse grid of cells and evaluates only their corners. A cell
+// whose corners disagree is split into four, most promising first, until a
+// node budget is spent. Every pixel that was never evaluated is then filled
+// from its leaf's corners.
+//
+// The corners of a cell are pixels, so neighbouring cells share them; a
+// per-pixel cache makes sure each one is computed once. Like any sampling
+// scheme this can miss a feature that lies strictly inside a cell whose
+// corners agree.
+
+// Cells are split in batches of this many per thread. Taking a batch off the
+// queue at once lets the corners of all its children be computed in
+// parallel, at the cost of following the priority order a bit less closely.
+const int QUADTREE_BATCH_PER_THREAD = 8;
+
+// A rectangle of pixels [x0, x1) x [y0, y1) and its estimated error: the
+// spread of its corner counts times its area.
+struct QuadCell {
+    int x0, y0, x1, y1;
+    long long error;
+    bool operator<(const QuadCell& other) const { return error < other.error; }
+};
+
+// What the quadtree renderer did, for the console and for tuning the budget.
+struct QuadtreeStats {
+    long long nodes = 0;      // Cells created, including the initial grid.
+    long long leaves = 0;
+    long long evaluated = 0;  // Pixels computed by the kernel.
+    int maxDepth = 0;         // Splits below the initial grid.
+    double seconds = 0.0;
+};
+
+// Renders an approximation of the frame with at most nodeBudget quadtree
+// cells. Pixels that were computed hold their exact count, the others are
+// bilinearly interpolated from the corners of their leaf.
+void renderQuadtree(const RenderSettings& settings, const Kernel& kernel, int numThreads,
+                    long long nodeBudget, FrameBuffer<int>& iterations, QuadtreeStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    const size_t width = settings.width;
+    iterations.allocate(width * settings.height, settings.hugePages);
+    std::vector<unsigned char> known(width * settings.height, 0);
+    stats = QuadtreeStats();
+
+    // Computes every pixel in 'points' that is not known yet, in parallel.
+    std::vector<size_t> pending;
+    auto evaluate = [&](const std::vector<size_t>& points) {
+        pending.clear();
+        for (size_t i : points) {
+            if (known[i]) continue;
+            known[i] = 1;
+            pending.push_back(i);
+        }
+        const int chunk = 64;
+        int chunks = static_cast<int>((pending.size() + chunk - 1) / chunk);
+        parallelFor(chunks, numThreads, [&](int c, int) {
+            size_t end = std::min(pending.size(), static_cast<size_t>(c + 1) * chunk);
+            for (size_t k = static_cast<size_t>(c) * chunk; k < end; ++k) {
+                int x = static_cast<int>(pending[k] % width);
+                int y = static_cast<int>(pending[k] / width);
+                kernel.renderRow(settings, y, x, x + 1, &iterations[pending[k]]);
+            }
+        });
+        stats.evaluated += pending.size();
+    };
+    auto corners = [&](const QuadCell& cell, std::vector<size_t>& points) {
+        for (int y : {cell.y0, cell.y1 - 1}) {
+            for (int x : {cell.x0, cell.x1 - 1}) points.push_back(y * width + x);
+        }
+    };
+    auto withError = [&](QuadCell cell) {
+        int low = settings.maxIterations;
+        int high = 0;
+        for (int y : {cell.y0, cell.y1 - 1}) {
+            for (int x : {cell.x0, cell.x1 - 1}) {
+                low = std::min(low, iterations[y * width + x]);
+                high = std::max(high, iterations[y * width + x]);
+            }
+        }
+        cell.error = static_cast<long long>(high - low) * (cell.x1 - cell.x0) * (cell.y1 - cell.y0);
+        return cell;
+    };
+
+    // The initial grid is the renderer's tile grid.
+    std::vector<QuadCell> cells;
+    std::vector<size_t> points;
+    for (const Tile& tile : makeTiles(settings, TILE_SIZE)) {
+        cells.push_back({tile.x0, tile.y0, tile.x1, tile.y1, 0});
+        corners(cells.back(), points);
+    }
+    evaluate(points);
+    stats.nodes = static_cast<long long>(cells.size());
+
+    // Cells whose corners agree, or that are all corners, are final leaves.
+    std::vector<QuadCell> leaves;
+    std::priority_queue<QuadCell> queue;
+    std::vector<int> depth(width * settings.height, 0);
+    auto place = [&](const QuadCell& cell) {
+        if (cell.error > 0 && (cell.x1 - cell.x0 > 2 || cell.y1 - cell.y0 > 2)) {
+            queue.push(cell);
+        } else {
+            leaves.push_back(cell);
+        }
+    };
+    for (const QuadCell& cell : cells) place(withError(cell));
+
+    const size_t batchSize = static_cast<size_t>(numThreads) * QUADTREE_BATCH_PER_THREAD;
+    while (!queue.empty() && stats.nodes + 4 <= nodeBudget) {
+        std::vector<QuadCell> children;
+        points.clear();
+        for (size_t b = 0; b < batchSize && !queue.empty() && stats.nodes + 4 <= nodeBudget; ++b) {
+            QuadCell parent = queue.top();
+            queue.pop();
+            int level = depth[parent.y0 * width + parent.x0] + 1;
+            stats.maxDepth = std::max(stats.maxDepth, level);
+            int xMid = (parent.x0 + parent.x1 + 1) / 2;
+            int yMid = (parent.y0 + parent.y1 + 1) / 2;
+            for (QuadCell child : {QuadCell{parent.x0, parent.y0, xMid, yMid, 0},
+                                   QuadCell{xMid, parent.y0, parent.x1, yMid, 0},
+                                   QuadCell{parent.x0, yMid, xMid, parent.y1, 0},
+                                   QuadCell{xMid, yMid, parent.x1, parent.y1, 0}}) {
+                if (child.x0 == child.x1 || child.y0 == child.y1) continue;
+                depth[child.y0 * width + child.x0] = level;
+                children.push_back(child);
+                corners(child, points);
+                ++stats.nodes;
+            }
+        }
+        evaluate(points);
+        for (const QuadCell& child : children) place(withError(child));
+    }
+    while (!queue.empty()) {
+        leaves.push_back(queue.top());
+        queue.pop();
+    }
+    stats.leaves = static_cast<long long>(leaves.size());
+
+    // Fill every leaf: exact counts where known, bilinear between the
+    // corners elsewhere. Leaves do not overlap, so they can be filled in parallel.
+    parallelFor(static_cast<int>(leaves.size()), numThreads, [&](int index, int) {
+        const QuadCell& cell = leaves[index];
+        double topLeft = iterations[cell.y0 * width + cell.x0];
+        double topRight = iterations[cell.y0 * width + cell.x1 - 1];
+        double bottomLeft = iterations[(cell.y1 - 1) * width + cell.x0];
+        double bottomRight = iterations[(cell.y1 - 1) * width + cell.x1 - 1];
+        double spanX = std::max(1, cell.x1 - cell.x0 - 1);
+        double spanY = std::max(1, cell.y1 - cell.y0 - 1);
+        for (int y = cell.y0; y < cell.y1; ++y) {
+            double v = (y - cell.y0) / spanY;
+            for (int x = cell.x0; x < cell.x1; ++x) {
+                size_t i = y * width + x;
+                if (known[i]) continue;
+                double u = (x - cell.x0) / spanX;
+                double value = (1 - v) * ((1 - u) * topLeft + u * topRight) +
+                               v * ((1 - u) * bottomLeft + u * bottomRight);
+                iterations[i] = static_cast<int>(value + 0.5);
+            }
+        }
+    });
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// --- Benchmark harness ---
+// The benchmark mode renders a few well-known views over and over and reports
+// throughput in the style of Google Benchmark. Each view stresses the kernel
+// differently: the full set mixes everything, the seahorse valley is a busy
+// boundary region, the deep interior never escapes (worst case) and the far
+// exterior escapes immediately (pure per-pixel overhead).
+
+// A named region of the complex plane.
+struct BenchmarkView {
+    const char* name;
+    double minReal, maxReal, minImaginary, maxImaginary;
+};
+
+const BenchmarkView BENCHMARK_VIEWS[] = {
+    {"full_set", -2.0, 1.0, -1.5, 1.5},
+    {"seahorse_valley", -0.7600, -0.7400, 0.0950, 0.1100},
+    {"deep_interior", -0.40, -0.10, -0.15, 0.15},
+    {"far_exterior", 2.5, 4.5, 1.5, 3.0},
+};
+
+// Image sizes every view is rendered at.
+const int BENCHMARK_SIZES[][2] = {
+    {320, 240},
+    {800, 600},
+    {1920, 1080},
+};
+
+// The measured result of one benchmark.
+struct BenchmarkResult {
+    std::string name;
+    long long frames;            // How many frames were rendered.
+    double nsPerFrame;           // Average wall time per frame.
+    double pixelsPerSecond;
+    double iterationsPerSecond;
+    double nsPerIteration;
+};
+
+// Renders frames until at least minTime seconds have been spent, doubling the
+// batch size each round like Google Benchmark does, and reports the averages.
+BenchmarkResult runBenchmark(const std::string& name, const RenderSettings& settings,
+                             const Kernel& kernel, int numThreads, double minTime) {
+    FrameBuffer<int> iterations;
+
+    // One untimed frame warms up the caches and tells us how much work a frame is.
+    renderIterations(settings, kernel, numThreads, iterations);
+    long long iterationsPerFrame = 0;
+    for (int count : iterations) {
+        iterationsPerFrame += iterationsExecuted(count, settings.maxIterations);
+    }
+
+    long long frames = 0;
+    double seconds = 0.0;
+    for (long long batch = 1; seconds < minTime; batch *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < batch; ++i) {
+            renderIterations(settings, kernel, numThreads, iterations);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        seconds += elapsed.count();
+        frames += batch;
+    }
+
+    double pixels = static_cast<double>(settings.width) * settings.height * frames;
+    double totalIterations = static_cast<double>(iterationsPerFrame) * frames;
+    BenchmarkResult result;
+    result.name = name;
+    result.frames = frames;
+    result.nsPerFrame = seconds * 1e9 / frames;
+    result.pixelsPerSecond = pixels / seconds;
+    result.iterationsPerSecond = totalIterations / seconds;
+    result.nsPerIteration = seconds * 1e9 / totalIterations;
+    return result;
+}
+
+// Writes the results in the same JSON layout Google Benchmark uses, so the
+// usual comparison scripts can track regressions between two runs.
+void writeBenchmarkJson(const std::string& path, const std::vector<BenchmarkResult>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Cannot write benchmark report to " << path << "\n";
+        return;
+    }
+
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    out << "{\n";
+    out << "  \"context\": {\n";
+    out << "    \"date\": \"" << date << "\",\n";
+    out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "    \"max_iterations\": " << MAX_ITERATIONS << "\n";
+    out << "  },\n";
+    out << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& r = results[i];
+        out << "    {\n";
+        out << "      \"name\": \"" << r.name << "\",\n";
+        out << "      \"run_name\": \"" << r.name << "\",\n";
+        out << "      \"run_type\": \"iteration\",\n";
+        out << "      \"iterations\": " << r.frames << ",\n";
+        out << "      \"real_time\": " << r.nsPerFrame << ",\n";
+        out << "      \"time_unit\": \"ns\",\n";
+        out << "      \"pixels_per_second\": " << r.pixelsPerSecond << ",\n";
+        out << "      \"iterations_per_second\": " << r.iterationsPerSecond << ",\n";
+        out << "      \"ns_per_iteration\": " << r.nsPerIteration << "\n";
+        out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// Runs every view x kernel x image size x thread count combination whose name
+// contains 'filter', prints a table and optionally writes a JSON report.
+// The renderer options in 'options' (symmetry, scheduling) are passed on to
+// every frame, so runs with and without them can be compared.
+int runBenchmarks(const std::string& filter, double minTime, const std::string& jsonPath,
+                  const RenderSettings& options) {
+    // Measure one thread, then powers of two up to the number of hardware threads.
+    int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> threadCounts;
+    for (int t = 1; t < hardwareThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(hardwareThreads);
+
+    std::printf("%-58s %14s %10s %14s %14s %10s\n", "Benchmark", "Time/frame", "Frames",
+                "Pixels/s", "Iterations/s", "ns/iter");
+    std::printf("%s\n", std::string(125, '-').c_str());
+
+    std::vector<BenchmarkResult> results;
+    for (const BenchmarkView& view : BENCHMARK_VIEWS) {
+        for (const Kernel& kernel : KERNELS) {
+            for (const auto& size : BENCHMARK_SIZES) {
+                for (int threads : threadCounts) {
+                    std::string name = std::string("BM_Render/") + view.name + "/" + kernel.name +
+                                       "/" + std::to_string(size[0]) + "x" +
+                                       std::to_string(size[1]) + "/threads:" +
+                                       std::to_string(threads);
+                    if (name.find(filter) == std::string::npos) continue;
+
+                    RenderSettings settings;
+                    settings.width = size[0];
+                    settings.height = size[1];
+                    settings.minReal = view.minReal;
+                    settings.maxReal = view.maxReal;
+                    settings.minImaginary = view.minImaginary;
+                    settings.maxImaginary = view.maxImaginary;
+                    settings.exploitSymmetry = options.exploitSymmetry;
+                    settings.hugePages = options.hugePages;
+                    settings.numaPlacement = options.numaPlacement;
+                    settings.schedule = options.schedule;
+
+                    BenchmarkResult r = runBenchmark(name, settings, kernel, threads, minTime);
+                    std::printf("%-58s %11.3f ms %10lld %14.4g %14.4g %10.3f\n", r.name.c_str(),
+                                r.nsPerFrame / 1e6, r.frames, r.pixelsPerSecond,
+                                r.iterationsPerSecond, r.nsPerIteration);
+                    std::fflush(stdout);
+                    results.push_back(r);
+                }
+            }
+        }
+    }
+
+    if (!jsonPath.empty()) writeBenchmarkJson(jsonPath, results);
+    return 0;
+}
+
+// --- Distributed rendering ---
+// Frames that are too big for one process are split into bands of rows and
+// rendered by several worker processes. A coordinator hands the bands out over
+// a Unix domain socket; the workers write their pixels straight into a shared
+// memory-mapped PGM file, so no pixel data ever travels over the socket.
+// The socket only carries short text lines:
+//
+//   coordinator -> worker   FRAME <width> <height> <minReal> <maxReal> <minImaginary>
+//                                 <maxImaginary> <maxIterations> <kernel> <mode>
+//                                 <symmetry> <path>
+//                           BAND <id> <y0> <y1>
+//                           QUIT
+//   worker -> coordinator   DONE <id>
+//
+// The coordinator forks its own local workers, and more can join from another
+// shell with --worker=SOCKET. Since the protocol is plain text lines, moving
+// workers to other machines only needs a TCP listener and a shared file system.
+//
+// A band that is still running long after most bands have finished (a slow or
+// overloaded worker, a "straggler") is handed to an idle worker as well. Both
+// copies write identical pixels, so whichever finishes first wins. A band whose
+// worker disconnects goes back into the queue.
+
+// Number of rows in one band handed to a worker.
+const int BAND_HEIGHT = 64;
+
+// A band counts as a straggler once it has run this many times longer than the
+// median band so far.
+const double STRAGGLER_FACTOR = 3.0;
+
+// The header of an 8-bit binary PGM ("P5") image. The pixels follow it as one
+// byte per pixel, row by row, which lets each worker compute where its rows go.
+std::string pgmHeader(int width, int height) {
+    return "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+}
+
+// Maps 'size' bytes of 'path' into memory, shared with every other process
+// that maps the same file. Returns nullptr on failure, and also if the file
+// is not exactly 'size' bytes long: then it is not the frame the coordinator
+// created (a worker in another directory, or another render's file).
+unsigned char* mapSharedFile(const std::string& path, size_t size) {
+    int fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) return nullptr;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) != size) {
+        close(fd);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open.
+    return data == MAP_FAILED ? nullptr : static_cast<unsigned char*>(data);
+}
+
+// Sends one line. MSG_NOSIGNAL turns a vanished peer into an error return
+// instead of a SIGPIPE that would kill the process.
+bool sendLine(int fd, const std::string& line) {
+    std::string message = line + "\n";
+    size_t sent = 0;
+    while (sent < message.size()) {
+        ssize_t n = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Reads whatever is available on 'fd' and appends every complete line to
+// 'lines'. Partial lines stay in 'buffer' until the rest arrives.
+// Returns false once the peer has closed the connection.
+bool readLines(int fd, std::string& buffer, std::vector<std::string>& lines) {
+    char chunk[4096];
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n <= 0) return false;
+    buffer.append(chunk, static_cast<size_t>(n));
+    size_t newline;
+    while ((newline = buffer.find('\n')) != std::string::npos) {
+        lines.push_back(buffer.substr(0, newline));
+        buffer.erase(0, newline + 1);
+    }
+    return true;
+}
+
+// Renders rows [y0, y1) as grayscale bytes, 'width' bytes per row starting at 'out'.
+void renderColorRows(const RenderSettings& settings, const Kernel& kernel, bool distanceMode,
+                     int y0, int y1, int numThreads, unsigned char* out) {
+    const double pixelSize = (settings.maxReal - settings.minReal) / settings.width;
+    parallelFor(y1 - y0, numThreads, [&](int row, int) {
+        int y = y0 + row;
+        unsigned char* pixels = out + static_cast<size_t>(row) * settings.width;
+        if (distanceMode) {
+            std::vector<double> distances(settings.width);
+            kernel.renderDistanceRow(settings, y, 0, settings.width, distances.data());
+            for (int x = 0; x < settings.width; ++x) {
+                pixels[x] = static_cast<unsigned char>(mapDistanceToColor(distances[x], pixelSize));
+            }
+        } else {
+            std::vector<int> iterations(settings.width);
+            kernel.renderRow(settings, y, 0, settings.width, iterations.data());
+            for (int x = 0; x < settings.width; ++x) {
+                pixels[x] = static_cast<unsigned char>(
+                    mapIterationsToColor(iterations[x], settings.maxIterations));
+            }
+        }
+    });
+}
+
+// The worker side: connect to the coordinator, then render bands until told to quit.
+// Mirrored rows inside a band are left for the coordinator to copy.
+int runWorker(const std::string& socketPath, int numThreads) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Worker cannot connect to " << socketPath << "\n";
+        return 1;
+    }
+
+    RenderSettings settings;
+    const Kernel* kernel = nullptr;
+    bool distanceMode = false;
+    std::vector<int> mirror;
+    unsigned char* pixels = nullptr;
+    size_t fileSize = 0;
+
+    std::string buffer;
+    std::vector<std::string> lines;
+    bool running = true;
+    while (running && readLines(fd, buffer, lines)) {
+        for (const std::string& line : lines) {
+            std::istringstream command(line);
+            std::string verb;
+            command >> verb;
+            if (verb == "FRAME") {
+                std::string kernelName, mode, path;
+                command >> settings.width >> settings.height >> settings.minReal >>
+                    settings.maxReal >> settings.minImaginary >> settings.maxImaginary >>
+                    settings.maxIterations >> kernelName >> mode >> settings.exploitSymmetry;
+                std::getline(command >> std::ws, path);
+                kernel = findKernel(kernelName);
+                distanceMode = mode == "distance";
+                mirror = findMirrorRows(settings);
+                size_t headerSize = pgmHeader(settings.width, settings.height).size();
+                fileSize = headerSize + static_cast<size_t>(settings.width) * settings.height;
+                unsigned char* file = kernel ? mapSharedFile(path, fileSize) : nullptr;
+                if (!file) {
+                    std::cerr << "Worker cannot set up frame: " << line << "\n";
+                    close(fd);
+                    return 1;
+                }
+                pixels = file + headerSize;
+            } else if (verb == "BAND" && pixels) {
+                int id, y0, y1;
+                command >> id >> y0 >> y1;
+                // Render each run of rows that is not a mirror of another row.
+                for (int y = y0; y < y1;) {
+                    if (mirror[y] >= 0) { ++y; continue; }
+                    int end = y;
+                    while (end < y1 && mirror[end] < 0) ++end;
+                    renderColorRows(settings, *kernel, distanceMode, y, end, numThreads,
+                                    pixels + static_cast<size_t>(y) * settings.width);
+                    y = end;
+                }
+                if (!sendLine(fd, "DONE " + std::to_string(id))) running = false;
+            } else if (verb == "QUIT") {
+                running = false;
+            }
+        }
+        lines.clear();
+    }
+
+    if (pixels) {
+        munmap(pixels - pgmHeader(settings.width, settings.height).size(), fileSize);
+    }
+    close(fd);
+    return 0;
+}
+
+// The coordinator side: create the output file, start 'numWorkers' local
+// workers and farm the bands out until every band is done.
+int runCoordinator(const RenderSettings& settings, const Kernel& kernel, bool distanceMode,
+                   int numWorkers, int threadsPerWorker, const std::string& outputPath,
+                   const std::string& socketPath) {
+    using Clock = std::chrono::steady_clock;
+
+    // 1. Create the output file at its full size. Workers map it themselves.
+    std::string header = pgmHeader(settings.width, settings.height);
+    size_t fileSize = header.size() + static_cast<size_t>(settings.width) * settings.height;
+    {
+        int fd = open(outputPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(fileSize)) != 0 ||
+            pwrite(fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())) {
+            std::cerr << "Cannot create " << outputPath << "\n";
+            if (fd >= 0) close(fd);
+            return 1;
+        }
+        close(fd);
+    }
+    // Workers may run in another directory, so tell them the absolute path.
+    std::string framePath = outputPath;
+    if (char* resolved = realpath(outputPath.c_str(), nullptr)) {
+        framePath = resolved;
+        std::free(resolved);
+    }
+
+    // 2. Listen for workers before starting any, so none of them can miss us.
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 64) != 0) {
+        std::cerr << "Cannot listen on " << socketPath << "\n";
+        return 1;
+    }
+
+    std::vector<pid_t> children;
+    for (int i = 0; i < numWorkers; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            _exit(runWorker(socketPath, threadsPerWorker));
+        }
+        if (pid > 0) children.push_back(pid);
+    }
+
+    // 3. Split the frame into bands, leaving out bands made only of mirrored rows.
+    struct Band {
+        int y0, y1;
+        int running = 0;    // How many workers are rendering it right now.
+        bool done = false;
+        Clock::time_point started;
+    };
+    std::vector<int> mirror = findMirrorRows(settings);
+    std::vector<Band> bands;
+    std::deque<int> pending;
+    for (int y = 0; y < settings.height; y += BAND_HEIGHT) {
+        Band band;
+        band.y0 = y;
+        band.y1 = std::min(y + BAND_HEIGHT, settings.height);
+        bool needed = false;
+        for (int row = band.y0; row < band.y1; ++row) needed = needed || mirror[row] < 0;
+        if (!needed) continue;
+        pending.push_back(static_cast<int>(bands.size()));
+        bands.push_back(band);
+    }
+
+    struct Worker {
+        int fd;
+        std::string buffer;
+        int band = -1;  // The band it is rendering, or -1 when idle.
+    };
+    std::vector<Worker> workers;
+    std::vector<double> bandSeconds;  // How long each finished band took.
+    size_t remaining = bands.size();
+
+    std::ostringstream frame;
+    frame.precision(17);
+    frame << "FRAME " << settings.width << " " << settings.height << " " << settings.minReal << " "
+          << settings.maxReal << " " << settings.minImaginary << " " << settings.maxImaginary << " "
+          << settings.maxIterations << " " << kernel.name << " "
+          << (distanceMode ? "distance" : "escape") << " " << settings.exploitSymmetry << " "
+          << framePath;
+
+    auto assign = [&](Worker& worker, int id) {
+        Band& band = bands[id];
+        if (band.running == 0) band.started = Clock::now();
+        ++band.running;
+        worker.band = id;
+        sendLine(worker.fd, "BAND " + std::to_string(id) + " " + std::to_string(band.y0) + " " +
+                                std::to_string(band.y1));
+    };
+
+    // 4. The scheduling loop.
+    while (remaining > 0) {
+        // Give every idle worker a pending band, or else a second copy of a straggler.
+        for (Worker& worker : workers) {
+            if (worker.band >= 0) continue;
+            if (!pending.empty()) {
+                assign(worker, pending.front());
+                pending.pop_front();
+            } else if (!bandSeconds.empty()) {
+                std::vector<double> sorted = bandSeconds;
+                std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+                double limit = STRAGGLER_FACTOR * sorted[sorted.size() / 2];
+                for (size_t id = 0; id < bands.size(); ++id) {
+                    const Band& band = bands[id];
+                    std::chrono::duration<double> age = Clock::now() - band.started;
+                    if (!band.done && band.running == 1 && age.count() > limit) {
+                        assign(worker, static_cast<int>(id));
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::vector<pollfd> fds;
+        fds.push_back({listener, POLLIN, 0});
+        for (const Worker& worker : workers) fds.push_back({worker.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) break;
+
+        std::vector<Worker> stillConnected;
+        for (size_t i = 0; i < workers.size(); ++i) {
+            Worker& worker = workers[i];
+            std::vector<std::string> lines;
+            bool connected = true;
+            if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                connected = readLines(worker.fd, worker.buffer, lines);
+            }
+            for (const std::string& line : lines) {
+                int id;
+                if (std::sscanf(line.c_str(), "DONE %d", &id) != 1 || id != worker.band) continue;
+                Band& band = bands[id];
+                --band.running;
+                worker.band = -1;
+                if (!band.done) {
+                    band.done = true;
+                    --remaining;
+                    std::chrono::duration<double> took = Clock::now() - band.started;
+                    bandSeconds.push_back(took.count());
+                }
+            }
+            if (connected) {
+                stillConnected.push_back(std::move(worker));
+                continue;
+            }
+            // The worker went away: put its unfinished band back in the queue.
+            close(worker.fd);
+            if (worker.band >= 0) {
+                Band& band = bands[worker.band];
+                if (--band.running == 0 && !band.done) pending.push_front(worker.band);
+            }
+        }
+        workers.swap(stillConnected);
+
+        // Only now add a new worker: 'fds' has no entry for it above.
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0 && sendLine(fd, frame.str())) workers.push_back({fd, std::string(), -1});
+        }
+
+        // Give up if every local worker has exited and nobody else is connected.
+        for (size_t i = 0; i < children.size();) {
+            if (waitpid(children[i], nullptr, WNOHANG) == children[i]) {
+                children.erase(children.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+        if (workers.empty() && children.empty() && numWorkers > 0) {
+            std::cerr << "All workers exited with " << remaining << " bands left\n";
+            break;
+        }
+    }
+
+    for (Worker& worker : workers) {
+        sendLine(worker.fd, "QUIT");
+        close(worker.fd);
+    }
+    for (pid_t child : children) waitpid(child, nullptr, 0);
+    close(listener);
+    unlink(socketPath.c_str());
+    if (remaining > 0) return 1;
+
+    // 5. Fill in the mirrored rows from the rows the workers rendered.
+    unsigned char* file = mapSharedFile(outputPath, fileSize);
+    if (!file) return 1;
+    unsigned char* pixels = file + header.size();
+    for (int y = 0; y < settings.height; ++y) {
+        if (mirror[y] < 0) continue;
+        std::memcpy(pixels + static_cast<size_t>(y) * settings.width,
+                    pixels + static_cast<size_t>(mirror[y]) * settings.width, settings.width);
+    }
+    munmap(file, fileSize);
+
+    std::cout << "Rendered " << settings.width << "x" << settings.height << " in " << bands.size()
+              << " bands to " << outputPath << "\n";
+    return 0;
+}
+
+// --- Parallel PNG encoding ---
+// A PNG stores its pixels as one zlib stream: every row is prefixed with a
+// filter byte, the rows are deflated, and the stream is cut into IDAT chunks,
+// each protected by a CRC-32. Deflating one big stream is inherently serial,
+// so, like pigz, we cut the image into bands of rows and deflate each band
+// as an independent raw deflate stream on its own thread. Every band except
+// the last ends with Z_SYNC_FLUSH, which pads it to a byte boundary with an
+// empty block, so the bands simply concatenate into one valid stream.
+// The checksums are computed per band in parallel as well and then merged with
+// zlib's adler32_combine / crc32_combine, which cost O(log n) per merge.
+
+// Aim for roughly this many bytes of filtered image data per band, enough to
+// keep deflate's compression ratio close to that of a single stream.
+const size_t PNG_BAND_BYTES = 256 * 1024;
+
+// Appends a 32-bit big-endian integer, the byte order PNG uses everywhere.
+void appendBigEndian(std::string& out, uint32_t value) {
+    out += static_cast<char>(value >> 24);
+    out += static_cast<char>(value >> 16);
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value);
+}
+
+// The Paeth predictor from the PNG specification.
+unsigned char paethPredictor(int left, int up, int upLeft) {
+    int p = left + up - upLeft;
+    int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - upLeft);
+    if (pa <= pb && pa <= pc) return static_cast<unsigned char>(left);
+    if (pb <= pc) return static_cast<unsigned char>(up);
+    return static_cast<unsigned char>(upLeft);
+}
+
+// Filters one row of 8-bit grayscale pixels into out[0 .. width], choosing the
+// filter with the smallest sum of absolute differences (the heuristic libpng
+// uses). 'previous' is the unfiltered row above, or nullptr for the first row.
+void filterPngRow(const unsigned char* row, const unsigned char* previous, int width,
+                  unsigned char* out) {
+    std::vector<unsigned char> candidate(width);
+    long long bestCost = -1;
+    for (int filter = 0; filter <= 4; ++filter) {
+        long long cost = 0;
+        for (int x = 0; x < width; ++x) {
+            int left = x > 0 ? row[x - 1] : 0;
+            int up = previous ? previous[x] : 0;
+            int upLeft = (previous && x > 0) ? previous[x - 1] : 0;
+            int predicted = 0;
+            switch (filter) {
+                case 1: predicted = left; break;
+                case 2: predicted = up; break;
+                case 3: predicted = (left + up) / 2; break;
+                case 4: predicted = paethPredictor(left, up, upLeft); break;
+            }
+            candidate[x] = static_cast<unsigned char>(row[x] - predicted);
+            cost += std::abs(static_cast<signed char>(candidate[x]));
+        }
+        if (bestCost < 0 || cost < bestCost) {
+            bestCost = cost;
+            out[0] = static_cast<unsigned char>(filter);
+            std::copy(candidate.begin(), candidate.end(), out + 1);
+        }
+    }
+}
+
+// Writes an 8-bit grayscale PNG of 'pixels' (row-major, width bytes per row),
+// deflating and checksumming bands of rows on numThreads threads.
+bool writePng(const std::string& path, const unsigned char* pixels, int width, int height,
+              int numThreads) {
+    const size_t stride = static_cast<size_t>(width) + 1; // Filter byte + pixels.
+    const int bandRows = static_cast<int>(std::max<size_t>(1, PNG_BAND_BYTES / stride));
+    const int bandCount = (height + bandRows - 1) / bandRows;
+
+    struct Band {
+        std::string deflated;
+        uLong adler = 0;     // Adler-32 of the filtered (uncompressed) rows.
+        uLong crc = 0;       // CRC-32 of the deflated bytes.
+        size_t rawSize = 0;
+        bool ok = false;
+    };
+    std::vector<Band> bands(bandCount);
+
+    // 1. Filter, deflate and checksum every band in parallel.
+    parallelFor(bandCount, numThreads, [&](int index, int) {
+        Band& band = bands[index];
+        int y0 = index * bandRows;
+        int y1 = std::min(y0 + bandRows, height);
+        std::vector<unsigned char> filtered(stride * (y1 - y0));
+        for (int y = y0; y < y1; ++y) {
+            const unsigned char* row = pixels + static_cast<size_t>(y) * width;
+            filterPngRow(row, y > 0 ? row - width : nullptr, width,
+                         filtered.data() + stride * (y - y0));
+        }
+        band.rawSize = filtered.size();
+        band.adler = adler32(adler32(0L, Z_NULL, 0), filtered.data(),
+                             static_cast<uInt>(filtered.size()));
+
+        // Negative window bits give raw deflate data without a zlib header or
+        // trailer; we write a single header and trailer for the whole image.
+        z_stream stream{};
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            return;
+        }
+        band.deflated.resize(deflateBound(&stream, static_cast<uLong>(filtered.size())) + 16);
+        stream.next_in = filtered.data();
+        stream.avail_in = static_cast<uInt>(filtered.size());
+        stream.next_out = reinterpret_cast<Bytef*>(&band.deflated[0]);
+        stream.avail_out = static_cast<uInt>(band.deflated.size());
+        int flush = index + 1 == bandCount ? Z_FINISH : Z_SYNC_FLUSH;
+        int status = deflate(&stream, flush);
+        band.ok = flush == Z_FINISH ? status == Z_STREAM_END : status == Z_OK;
+        band.deflated.resize(stream.total_out);
+        deflateEnd(&stream);
+        band.crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(band.deflated.data()),
+                         static_cast<uInt>(band.deflated.size()));
+    });
+    for (const Band& band : bands) {
+        if (!band.ok) return false;
+    }
+
+    // 2. Stitch the bands together: one IDAT chunk per band. The first chunk also
+    // carries the zlib header and the last one the Adler-32 of all the rows.
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (const Band& band : bands) {
+        adler = adler32_combine(adler, band.adler, static_cast<z_off_t>(band.rawSize));
+    }
+
+    std::string png("\x89PNG\r\n\x1a\n", 8);
+    auto appendChunk = [&](const char* type, const std::string& data, uLong dataCrc) {
+        appendBigEndian(png, static_cast<uint32_t>(data.size()));
+        png.append(type, 4);
+        png += data;
+        uLong crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(type), 4);
+        appendBigEndian(png, static_cast<uint32_t>(
+                                 crc32_combine(crc, dataCrc, static_cast<z_off_t>(data.size()))));
+    };
+    auto crcOf = [](const std::string& data) {
+        return crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(data.data()),
+                     static_cast<uInt>(data.size()));
+    };
+
+    std::string header;
+    appendBigEndian(header, static_cast<uint32_t>(width));
+    appendBigEndian(header, static_cast<uint32_t>(height));
+    header += std::string("\x08\x00\x00\x00\x00", 5); // 8-bit grayscale, no interlacing.
+    appendChunk("IHDR", header, crcOf(header));
+
+    const std::string zlibHeader("\x78\x9c", 2); // Deflate, 32K window, default level.
+    std::string zlibTrailer;
+    appendBigEndian(zlibTrailer, static_cast<uint32_t>(adler));
+    for (int i = 0; i < bandCount; ++i) {
+        const Band& band = bands[i];
+        if (i == 0 || i + 1 == bandCount) {
+            // Only the first and last chunk need the band's CRC extended with the
+            // header or trailer bytes.
+            std::string data = (i == 0 ? zlibHeader : "") + band.deflated +
+                               (i + 1 == bandCount ? zlibTrailer : "");
+            uLong crc = i == 0 ? crcOf(zlibHeader) : crc32(0L, Z_NULL, 0);
+            crc = crc32_combine(crc, band.crc, static_cast<z_off_t>(band.deflated.size()));
+            if (i + 1 == bandCount) {
+                crc = crc32_combine(crc, crcOf(zlibTrailer), static_cast<z_off_t>(zlibTrailer.size()));
+            }
+            appendChunk("IDAT", data, crc);
+        } else {
+            appendChunk("IDAT", band.deflated, band.crc);
+        }
+    }
+    appendChunk("IEND", std::string(), crc32(0L, Z_NULL, 0));
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(png.data(), static_cast<std::streamsize>(png.size()));
+    return static_cast<bool>(out);
+}
+
+// --- Tile cost instrumentation ---
+// With --tile-stats=PREFIX the renderer writes what every tile cost:
+//   PREFIX.csv   one line per tile
+//   PREFIX.json  the same tiles plus a per-worker summary
+//   PREFIX.png   a heatmap the size of the frame, each tile shaded by its wall
+//                time (white = the slowest tile)
+// The per-worker totals show load imbalance at a glance: with good scheduling
+// every worker's busy time is about the same.
+
+// Per-worker totals derived from the tile list.
+struct WorkerStats {
+    int tiles = 0;
+    long long iterations = 0;
+    long long wallNs = 0;
+};
+
+std::vector<WorkerStats> summarizeWorkers(const std::vector<TileStats>& stats) {
+    std::vector<WorkerStats> workers;
+    for (const TileStats& tile : stats) {
+        if (tile.worker >= static_cast<int>(workers.size())) workers.resize(tile.worker + 1);
+        WorkerStats& worker = workers[tile.worker];
+        ++worker.tiles;
+        worker.iterations += tile.iterations;
+        worker.wallNs += tile.wallNs;
+    }
+    return workers;
+}
+
+bool writeTileStats(const std::string& prefix, const RenderSettings& settings,
+                    const std::vector<TileStats>& stats, int numThreads) {
+    std::ofstream csv(prefix + ".csv");
+    csv << "x0,y0,x1,y1,pixels,iterations,escapes,interior,wall_ns,worker\n";
+    for (const TileStats& t : stats) {
+        csv << t.tile.x0 << "," << t.tile.y0 << "," << t.tile.x1 << "," << t.tile.y1 << ","
+            << t.pixels << "," << t.iterations << "," << t.escapes << "," << t.interior << ","
+            << t.wallNs << "," << t.worker << "\n";
+    }
+
+    std::vector<WorkerStats> workers = summarizeWorkers(stats);
+    std::ofstream json(prefix + ".json");
+    json << "{\n  \"width\": " << settings.width << ",\n  \"height\": " << settings.height
+         << ",\n  \"max_iterations\": " << settings.maxIterations << ",\n  \"tiles\": [\n";
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const TileStats& t = stats[i];
+        json << "    {\"x0\": " << t.tile.x0 << ", \"y0\": " << t.tile.y0 << ", \"x1\": " << t.tile.x1
+             << ", \"y1\": " << t.tile.y1 << ", \"pixels\": " << t.pixels
+             << ", \"iterations\": " << t.iterations << ", \"escapes\": " << t.escapes
+             << ", \"interior\": " << t.interior << ", \"wall_ns\": " << t.wallNs
+             << ", \"worker\": " << t.worker << "}" << (i + 1 < stats.size() ? "," : "") << "\n";
+    }
+    json << "  ],\n  \"workers\": [\n";
+    for (size_t i = 0; i < workers.size(); ++i) {
+        json << "    {\"worker\": " << i << ", \"tiles\": " << workers[i].tiles
+             << ", \"iterations\": " << workers[i].iterations << ", \"wall_ns\": "
+             << workers[i].wallNs << "}" << (i + 1 < workers.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+
+    long long slowest = 1;
+    for (const TileStats& t : stats) slowest = std::max(slowest, t.wallNs);
+    std::vector<unsigned char> heatmap(static_cast<size_t>(settings.width) * settings.height, 0);
+    for (const TileStats& t : stats) {
+        unsigned char shade = static_cast<unsigned char>(255 * t.wallNs / slowest);
+        for (int y = t.tile.y0; y < t.tile.y1; ++y) {
+            std::fill(heatmap.begin() + static_cast<size_t>(y) * settings.width + t.tile.x0,
+                      heatmap.begin() + static_cast<size_t>(y) * settings.width + t.tile.x1, shade);
+        }
+    }
+    bool ok = csv && json &&
+              writePng(prefix + ".png", heatmap.data(), settings.width, settings.height, numThreads);
+
+    std::cout << "Tile stats: " << stats.size() << " tiles -> " << prefix << ".{csv,json,png}\n";
+    for (size_t i = 0; i < workers.size(); ++i) {
+        std::cout << "  worker " << i << ": " << workers[i].tiles << " tiles, "
+                  << workers[i].wallNs / 1000000.0 << " ms busy\n";
+    }
+    return ok;
+}
+
+// --- Out-of-core image pyramid ---
+// A 100k x 100k frame is 10 GB even at one byte per pixel, so instead of
+// holding the whole image we render it one band of rows at a time and stream
+// it into a Deep Zoom image pyramid on disk:
+//
+//   NAME.dzi                      XML descriptor (size, tile size, format)
+//   NAME_files/<level>/<col>_<row>.pgm
+//
+// The largest level holds the full-resolution tiles. Each smaller level is half
+// the width and height of the one above it (rounded up), down to a single
+// pixel at level 0. Every level keeps just the rows it needs to complete its
+// current row of tiles. Once a tile row is full it is written out, and pairs of
+// its rows are averaged into one row of the next smaller level. The tile size
+// must therefore be even. Resident memory depends on the image width and tile
+// size, never on the height.
+
+// Smallest tile size we fall back to when squeezing into the memory budget.
+const int MIN_PYRAMID_TILE_SIZE = 64;
+
+class PyramidWriter {
+public:
+    PyramidWriter(const std::string& name, int width, int height, int tileSize)
+        : name_(name), tileSize_(tileSize) {
+        // Deep Zoom numbers levels so that level L is 2^L pixels wide for a square image.
+        int maxLevel = 0;
+        while ((1LL << maxLevel) < std::max(width, height)) ++maxLevel;
+        for (int level = 0; level <= maxLevel; ++level) {
+            int shift = maxLevel - level;
+            Level l;
+            l.width = static_cast<int>((width + (1LL << shift) - 1) >> shift);
+            l.height = static_cast<int>((height + (1LL << shift) - 1) >> shift);
+            levels_.push_back(l);
+        }
+    }
+
+    // Upper bound on the bytes buffered by all levels together. A level can
+    // hold up to a full tile row plus the rows pushed while it fills, hence 2x.
+    static size_t estimateBytes(int width, int tileSize) {
+        size_t bytes = 0;
+        for (long long w = width; ; w = (w + 1) / 2) {
+            bytes += static_cast<size_t>(w) * 2 * tileSize;
+            if (w == 1) break;
+        }
+        return bytes;
+    }
+
+    // Creates the directory tree and writes the .dzi descriptor.
+    bool begin() {
+        std::string files = name_ + "_files";
+        if (mkdir(files.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        for (size_t level = 0; level < levels_.size(); ++level) {
+            std::string dir = files + "/" + std::to_string(level);
+            if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        }
+        const Level& base = levels_.back();
+        std::ofstream dzi(name_ + ".dzi");
+        dzi << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            << "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"pgm\""
+            << " Overlap=\"0\" TileSize=\"" << tileSize_ << "\">\n"
+            << "  <Size Width=\"" << base.width << "\" Height=\"" << base.height << "\"/>\n"
+            << "</Image>\n";
+        return static_cast<bool>(dzi);
+    }
+
+    // Feeds the next 'count' full-resolution rows (width bytes each) into the pyramid.
+    bool pushBaseRows(const unsigned char* rows, int count) {
+        return pushRows(static_cast<int>(levels_.size()) - 1, rows, count);
+    }
+
+    int levelCount() const { return static_cast<int>(levels_.size()); }
+
+    // The first level that has not written all of its rows as tiles, or -1
+    // once every level is complete.
+    int incompleteLevel() const {
+        for (size_t level = 0; level < levels_.size(); ++level) {
+            if (levels_[level].rowsWritten != levels_[level].height) return static_cast<int>(level);
+        }
+        return -1;
+    }
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        int rowsReceived = 0;            // Rows pushed into this level so far.
+        int rowsWritten = 0;             // Rows already written out as tiles.
+        std::vector<unsigned char> rows; // Rows received but not yet written.
+    };
+
+    bool pushRows(int level, const unsigned char* rows, int count) {
+        Level& l = levels_[level];
+        l.rows.insert(l.rows.end(), rows, rows + static_cast<size_t>(count) * l.width);
+        l.rowsReceived += count;
+
+        int buffered = l.rowsReceived - l.rowsWritten;
+        while (buffered >= tileSize_ || (l.rowsReceived == l.height && buffered > 0)) {
+            int n = std::min(tileSize_, buffered);
+            if (!writeTileRow(level, n)) return false;
+
+            // Average pairs of rows (and pairs of pixels within them) into the
+            // next smaller level. n is even except for the last tile row, whose
+            // odd final row is paired with itself.
+            if (level > 0) {
+                const Level& smaller = levels_[level - 1];
+                int halfRows = (n + 1) / 2;
+                std::vector<unsigned char> half(static_cast<size_t>(halfRows) * smaller.width);
+                for (int y = 0; y < halfRows; ++y) {
+                    const unsigned char* top = l.rows.data() + static_cast<size_t>(2 * y) * l.width;
+                    const unsigned char* bottom = 2 * y + 1 < n ? top + l.width : top;
+                    for (int x = 0; x < smaller.width; ++x) {
+                        int x0 = 2 * x;
+                        int x1 = std::min(2 * x + 1, l.width - 1);
+                        half[static_cast<size_t>(y) * smaller.width + x] = static_cast<unsigned char>(
+                            (top[x0] + top[x1] + bottom[x0] + bottom[x1] + 2) / 4);
+                    }
+                }
+                if (!pushRows(level - 1, half.data(), halfRows)) return false;
+            }
+
+            l.rows.erase(l.rows.begin(), l.rows.begin() + static_cast<size_t>(n) * l.width);
+            l.rowsWritten += n;
+            buffered -= n;
+        }
+        return true;
+    }
+
+    // Writes the first 'n' buffered rows of 'level' as one row of tiles.
+    bool writeTileRow(int level, int n) {
+        const Level& l = levels_[level];
+        int tileRow = l.rowsWritten / tileSize_;
+        for (int column = 0; column * tileSize_ < l.width; ++column) {
+            int x0 = column * tileSize_;
+            int tileWidth = std::min(tileSize_, l.width - x0);
+            std::string path = name_ + "_files/" + std::to_string(level) + "/" +
+                               std::to_string(column) + "_" + std::to_string(tileRow) + ".pgm";
+            std::ofstream tile(path, std::ios::binary);
+            tile << pgmHeader(tileWidth, n);
+            for (int y = 0; y < n; ++y) {
+                tile.write(reinterpret_cast<const char*>(l.rows.data()) +
+                               static_cast<size_t>(y) * l.width + x0,
+                           tileWidth);
+            }
+            if (!tile) return false;
+        }
+        return true;
+    }
+
+    std::string name_;
+    int tileSize_;
+    std::vector<Level> levels_;
+};
+
+// Renders the frame band by band into a Deep Zoom pyramid called 'name'.
+// The tile size is rounded up to even, then halved (down to
+// MIN_PYRAMID_TILE_SIZE) until the estimated resident memory fits into 'budgetBytes'.
+int renderPyramid(const RenderSettings& settings, const Kernel& kernel, bool distanceMode,
+                  int numThreads, const std::string& name, int tileSize, size_t budgetBytes) {
+    auto roundUpToEven = [](int size) { return size + size % 2; };
+    // One band of full-resolution rows plus the pyramid's own row buffers and
+    // each thread's scratch row (up to 8 bytes per pixel in distance mode).
+    auto residentBytes = [&](int size) {
+        return static_cast<size_t>(settings.width) * size +
+               PyramidWriter::estimateBytes(settings.width, size) +
+               static_cast<size_t>(settings.width) * 8 * numThreads;
+    };
+    tileSize = roundUpToEven(tileSize);
+    while (residentBytes(tileSize) > budgetBytes && tileSize / 2 >= MIN_PYRAMID_TILE_SIZE) {
+        tileSize = roundUpToEven(tileSize / 2);
+    }
+    if (residentBytes(tileSize) > budgetBytes) {
+        std::cerr << "A " << settings.width << " pixel wide pyramid needs at least "
+                  << residentBytes(tileSize) / (1024 * 1024) + 1 << " MB\n";
+        return 1;
+    }
+
+    PyramidWriter pyramid(name, settings.width, settings.height, tileSize);
+    if (!pyramid.begin()) {
+        std::cerr << "Cannot create pyramid " << name << "\n";
+        return 1;
+    }
+
+    std::vector<unsigned char> band(static_cast<size_t>(settings.width) * tileSize);
+    for (int y = 0; y < settings.height; y += tileSize) {
+        int rows = std::min(tileSize, settings.height - y);
+        renderColorRows(settings, kernel, distanceMode, y, y + rows, numThreads, band.data());
+        if (!pyramid.pushBaseRows(band.data(), rows)) {
+            std::cerr << "Cannot write pyramid tiles for " << name << "\n";
+            return 1;
+        }
+    }
+    int incomplete = pyramid.incompleteLevel();
+    if (incomplete >= 0) {
+        std::cerr << "Pyramid " << name << " is incomplete: level " << incomplete
+                  << " is missing tile rows\n";
+        return 1;
+    }
+
+    std::cout << "Wrote " << name << ".dzi: " << settings.width << "x" << settings.height << ", "
+              << pyramid.levelCount() << " levels of " << tileSize << "px tiles, about "
+              << residentBytes(tileSize) / (1024 * 1024) << " MB resident\n";
+    return 0;
+}
+
+// --- Buddhabrot ---
+// The Buddhabrot turns the escape-time picture inside out. Instead of coloring
+// each 'c' by how fast it escapes, we pick many random points 'c', and for every
+// one whose orbit escapes we mark every pixel its orbit z_1, z_2, ... passes
+// through. Bright pixels are places that escaping orbits visit often.
+//
+// Every orbit can land anywhere in the image, so threads cannot own pixels
+// the way they own tiles. Giving each thread its own private histogram and
+// adding the histograms up when a snapshot is requested keeps the hot loop free
+// of atomics and shared cache lines.
+//
+// Most random points either never escape or escape before their orbit enters
+// the view, which makes plain uniform sampling slow for zoomed-in views.
+// Metropolis-Hastings sampling fixes that: each thread runs a Markov chain that
+// proposes a small random step from its current 'c' (or, now and then, a fresh
+// uniform point) and accepts it with probability min(1, f(new) / f(current)),
+// where f is the number of orbit points that land in the view. The chain then
+// spends its time on points with interesting orbits. Each orbit is recorded
+// with weight 1 / f so that the picture still matches uniform sampling.
+
+// Random points 'c' are drawn from this square, which contains the whole set.
+const double BUDDHABROT_SAMPLE_RADIUS = 2.0;
+
+// Metropolis-Hastings: probability of proposing a fresh uniform point instead
+// of a small step, and the standard deviation of a small step.
+const double BUDDHABROT_RESTART_PROBABILITY = 0.2;
+const double BUDDHABROT_MUTATION_SIZE = 0.002;
+
+enum class BuddhabrotSampler { Uniform, Metropolis };
+
+class BuddhabrotRenderer {
+public:
+    BuddhabrotRenderer(const RenderSettings& settings, BuddhabrotSampler sampler, int numThreads,
+                       unsigned seed)
+        : settings_(settings), sampler_(sampler), workers_(std::max(1, numThreads)) {
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            Worker& worker = workers_[i];
+            worker.histogram.assign(static_cast<size_t>(settings.width) * settings.height, 0.0);
+            worker.rng.seed(seed + 7919 * static_cast<unsigned>(i));
+        }
+    }
+
+    // Traces 'samples' more random points, split evenly over the threads.
+    // Can be called repeatedly to refine the image progressively.
+    void run(long long samples) {
+        int threads = static_cast<int>(workers_.size());
+        parallelFor(threads, threads, [&](int index, int) {
+            long long share = samples / threads + (index < samples % threads ? 1 : 0);
+            Worker& worker = workers_[index];
+            for (long long i = 0; i < share; ++i) {
+                if (sampler_ == BuddhabrotSampler::Uniform) {
+                    sampleUniform(worker);
+                } else {
+                    sampleMetropolis(worker);
+                }
+            }
+        });
+        samplesTaken_ += samples;
+    }
+
+    // Merges the per-thread histograms into a grayscale image. Brightness is
+    // the square root of the visit density, scaled so the brightest pixel is 255.
+    // Must not be called while run() is in progress.
+    std::vector<unsigned char> snapshot() const {
+        std::vector<double> total(workers_[0].histogram.size(), 0.0);
+        for (const Worker& worker : workers_) {
+            for (size_t i = 0; i < total.size(); ++i) total[i] += worker.histogram[i];
+        }
+        double brightest = *std::max_element(total.begin(), total.end());
+        std::vector<unsigned char> image(total.size());
+        for (size_t i = 0; i < total.size(); ++i) {
+            double t = brightest > 0.0 ? std::sqrt(total[i] / brightest) : 0.0;
+            image[i] = static_cast<unsigned char>(255 * t);
+        }
+        return image;
+    }
+
+    long long samplesTaken() const { return samplesTaken_; }
+
+    // Fraction of Metropolis-Hastings proposals that were accepted.
+    double acceptanceRate() const {
+        long long proposed = 0, accepted = 0;
+        for (const Worker& worker : workers_) {
+            proposed += worker.proposed;
+            accepted += worker.accepted;
+        }
+        return proposed > 0 ? static_cast<double>(accepted) / proposed : 0.0;
+    }
+
+private:
+    // Everything one thread touches while sampling. Nothing in here is shared.
+    struct Worker {
+        std::vector<double> histogram;
+        std::vector<int> orbit;     // Pixels visited by the orbit traced last.
+        std::vector<int> chainOrbit; // Spare buffer holding the chain's orbit during a proposal.
+        std::mt19937_64 rng;
+        double cReal = 0.0, cImaginary = 0.0;
+        int contribution = 0;       // f(c) of the chain's current point.
+        long long proposed = 0, accepted = 0;
+    };
+
+    double uniform(Worker& worker, double low, double high) {
+        return std::uniform_real_distribution<double>(low, high)(worker.rng);
+    }
+
+    // Iterates c and stores the pixel of every orbit point in worker.orbit.
+    // Returns f(c), the number of orbit points inside the view, or 0 if the
+    // orbit does not escape (interior points are not part of the Buddhabrot).
+    int traceOrbit(Worker& worker, double cReal, double cImaginary) {
+        worker.orbit.clear();
+        // Points in the main cardioid or the period-2 bulb never escape; skip
+        // them without iterating (the two standard closed-form tests).
+        double q = (cReal - 0.25) * (cReal - 0.25) + cImaginary * cImaginary;
+        if (q * (q + (cReal - 0.25)) <= 0.25 * cImaginary * cImaginary ||
+            (cReal + 1.0) * (cReal + 1.0) + cImaginary * cImaginary <= 1.0 / 16.0) {
+            return 0;
+        }
+
+        const double scaleX = settings_.width / (settings_.maxReal - settings_.minReal);
+        const double scaleY = settings_.height / (settings_.maxImaginary - settings_.minImaginary);
+        double zReal = 0.0, zImaginary = 0.0;
+        int inView = 0;
+        for (int i = 0; i < settings_.maxIterations; ++i) {
+            double zRealSquared = zReal * zReal;
+            double zImaginarySquared = zImaginary * zImaginary;
+            zImaginary = 2.0 * zReal * zImaginary + cImaginary;
+            zReal = zRealSquared - zImaginarySquared + cReal;
+            if (zReal * zReal + zImaginary * zImaginary > 4.0) return inView;
+
+            double px = (zReal - settings_.minReal) * scaleX;
+            double py = (settings_.maxImaginary - zImaginary) * scaleY;
+            if (px >= 0.0 && px < settings_.width && py >= 0.0 && py < settings_.height) {
+                worker.orbit.push_back(static_cast<int>(py) * settings_.width + static_cast<int>(px));
+                ++inView;
+            }
+        }
+        return 0;
+    }
+
+    void record(Worker& worker, double weight) {
+        for (int pixel : worker.orbit) worker.histogram[pixel] += weight;
+    }
+
+    void sampleUniform(Worker& worker) {
+        double cReal = uniform(worker, -BUDDHABROT_SAMPLE_RADIUS, BUDDHABROT_SAMPLE_RADIUS);
+        double cImaginary = uniform(worker, -BUDDHABROT_SAMPLE_RADIUS, BUDDHABROT_SAMPLE_RADIUS);
+        if (traceOrbit(worker, cReal, cImaginary) > 0) record(worker, 1.0);
+    }
+
+    void sampleMetropolis(Worker& worker) {
+        // Start the chain on some point whose orbit reaches the view.
+        for (int tries = 0; worker.contribution == 0 && tries < 10000; ++tries) {
+            worker.cReal = uniform(worker, -BUDDHABROT_SAMPLE_RADIUS, BUDDHABROT_SAMPLE_RADIUS);
+            worker.cImaginary = uniform(worker, -BUDDHABROT_SAMPLE_RADIUS, BUDDHABROT_SAMPLE_RADIUS);
+            worker.contribution = traceOrbit(worker, worker.cReal, worker.cImaginary);
+        }
+        if (worker.contribution == 0) return;
+
+        // Propose a new point. The mixture of "fresh uniform point" and "small
+        // Gaussian step" is symmetric, so the acceptance test needs no
+        // proposal-density correction.
+        double cReal, cImaginary;
+        if (uniform(worker, 0.0, 1.0) < BUDDHABROT_RESTART_PROBABILITY) {
+            cReal = uniform(worker, -BUDDHABROT_SAMPLE_RADIUS, BUDDHABROT_SAMPLE_RADIUS);
+            cImaginary = uniform(worker, -BUDDHABROT_SAMPLE_RADIUS, BUDDHABROT_SAMPLE_RADIUS);
+        } else {
+            std::normal_distribution<double> step(0.0, BUDDHABROT_MUTATION_SIZE);
+            cReal = worker.cReal + step(worker.rng);
+            cImaginary = worker.cImaginary + step(worker.rng);
+        }
+
+        ++worker.proposed;
+        int contribution = 0;
+        worker.chainOrbit.swap(worker.orbit);
+        if (std::abs(cReal) <= BUDDHABROT_SAMPLE_RADIUS &&
+            std::abs(cImaginary) <= BUDDHABROT_SAMPLE_RADIUS) {
+            contribution = traceOrbit(worker, cReal, cImaginary);
+        }
+        if (contribution > 0 &&
+            uniform(worker, 0.0, 1.0) * worker.contribution < contribution) {
+            ++worker.accepted;
+            worker.cReal = cReal;
+            worker.cImaginary = cImaginary;
+            worker.contribution = contribution;
+        } else {
+            worker.orbit.swap(worker.chainOrbit);
+        }
+
+        // Record the chain's current point, weighted by 1 / f.
+        record(worker, 1.0 / worker.contribution);
+    }
+
+    RenderSettings settings_;
+    BuddhabrotSampler sampler_;
+    std::vector<Worker> workers_;
+    long long samplesTaken_ = 0;
+};
+
+// Renders 'samples' Buddhabrot samples in 'rounds' equal rounds, saving a
+// snapshot PNG to 'path' after each round so progress can be watched.
+int renderBuddhabrot(const RenderSettings& settings, BuddhabrotSampler sampler, int numThreads,
+                     long long samples, int rounds, const std::string& path) {
+    BuddhabrotRenderer renderer(settings, sampler, numThreads, 12345);
+    rounds = std::max(1, rounds);
+    for (int round = 0; round < rounds; ++round) {
+        renderer.run(samples / rounds + (round < samples % rounds ? 1 : 0));
+        std::vector<unsigned char> image = renderer.snapshot();
+        // Write to a temporary name and rename, so a viewer never sees half a file.
+        std::string temporary = path + ".tmp";
+        if (!writePng(temporary, image.data(), settings.width, settings.height, numThreads) ||
+            std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::cerr << "Cannot write " << path << "\n";
+            return 1;
+        }
+        std::cout << "Buddhabrot snapshot " << round + 1 << "/" << rounds << ": "
+                  << renderer.samplesTaken() << " samples";
+        if (sampler == BuddhabrotSampler::Metropolis) {
+            std::cout << ", acceptance " << renderer.acceptanceRate();
+        }
+        std::cout << " -> " << path << "\n";
+    }
+    return 0;
+}
+
+// --- Raw iteration counts ---
+// The PNG and PGM outputs keep only a gray level per pixel. For analysis and
+// recoloring the raw iteration counts are more useful, so they can also be
+// written to a simple binary file:
+//
+//   RawHeader                 (fixed size, see below)
+//   counts                    width * height uint16 or uint32, row-major
+//   fractions (optional)      width * height float, at header.fractionOffset
+//
+// Numbers are stored in the byte order of the machine that wrote the file
+// (little-endian on x86 and ARM). Everything sits at a fixed offset, so a
+// reader can mmap the file and look up any pixel without parsing or copying
+// (see RawIterationFile).
+
+const char RAW_MAGIC[8] = {'M', 'A', 'N', 'D', 'I', 'T', 'E', 'R'};
+const uint32_t RAW_VERSION = 1;
+
+struct RawHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;     // sizeof(RawHeader): the counts start here.
+    uint32_t width, height;
+    double minReal, maxReal, minImaginary, maxImaginary;
+    uint32_t maxIterations;
+    uint32_t countBytes;      // 2 (uint16) or 4 (uint32) bytes per count.
+    uint64_t fractionOffset;  // Where the fractions start, or 0 if there are none.
+    char kernel[32];          // Name of the kernel that rendered the counts.
+};
+static_assert(sizeof(RawHeader) == 104, "the header layout is part of the file format");
+
+// Writes iteration counts (and, if given, their fractional parts) to 'path'.
+// Counts use 16 bits when maxIterations fits, 32 bits otherwise. The file is
+// created at its full size and filled through a shared mapping, one row per
+// parallelFor index.
+bool writeRawIterations(const std::string& path, const RenderSettings& settings,
+                        const std::string& kernelName, const FrameBuffer<int>& counts,
+                        const FrameBuffer<float>* fractions, int numThreads) {
+    const size_t pixels = static_cast<size_t>(settings.width) * settings.height;
+    RawHeader header = {};
+    std::memcpy(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC));
+    header.version = RAW_VERSION;
+    header.headerBytes = sizeof(RawHeader);
+    header.width = settings.width;
+    header.height = settings.height;
+    header.minReal = settings.minReal;
+    header.maxReal = settings.maxReal;
+    header.minImaginary = settings.minImaginary;
+    header.maxImaginary = settings.maxImaginary;
+    header.maxIterations = settings.maxIterations;
+    header.countBytes = settings.maxIterations <= UINT16_MAX ? 2 : 4;
+    std::strncpy(header.kernel, kernelName.c_str(), sizeof(header.kernel) - 1);
+    size_t fileSize = sizeof(RawHeader) + pixels * header.countBytes;
+    if (fractions) {
+        header.fractionOffset = (fileSize + 7) / 8 * 8;
+        fileSize = header.fractionOffset + pixels * sizeof(float);
+    }
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool sized = ftruncate(fd, static_cast<off_t>(fileSize)) == 0;
+    close(fd);
+    unsigned char* file = sized ? mapSharedFile(path, fileSize) : nullptr;
+    if (!file) return false;
+
+    std::memcpy(file, &header, sizeof(header));
+    unsigned char* data = file + sizeof(RawHeader);
+    parallelFor(settings.height, numThreads, [&](int y, int) {
+        size_t begin = static_cast<size_t>(y) * settings.width;
+        size_t end = begin + settings.width;
+        if (header.countBytes == 2) {
+            uint16_t* out = reinterpret_cast<uint16_t*>(data);
+            for (size_t i = begin; i < end; ++i) out[i] = static_cast<uint16_t>(counts[i]);
+        } else {
+            uint32_t* out = reinterpret_cast<uint32_t*>(data);
+            for (size_t i = begin; i < end; ++i) out[i] = static_cast<uint32_t>(counts[i]);
+        }
+        if (fractions) {
+            std::memcpy(file + header.fractionOffset + begin * sizeof(float),
+                        fractions->data() + begin, settings.width * sizeof(float));
+        }
+    });
+    return munmap(file, fileSize) == 0;
+}
+
+// Read-only view of a raw iteration file. The file is mapped, not read, so
+// opening is instant whatever its size and only the pages that are looked at
+// are loaded from disk.
+class RawIterationFile {
+public:
+    RawIterationFile() = default;
+    RawIterationFile(const RawIterationFile&) = delete;
+    RawIterationFile& operator=(const RawIterationFile&) = delete;
+    ~RawIterationFile() { close(); }
+
+    // Maps 'path' and checks its header. Returns false (with the reason in
+    // error()) if the file cannot be opened or is not a valid raw file.
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            if (fd >= 0) ::close(fd);
+            return fail("cannot open file");
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        void* data = size_ >= sizeof(RawHeader)
+                         ? mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0)
+                         : MAP_FAILED;
+        ::close(fd); // The mapping keeps the file open.
+        if (data == MAP_FAILED) return fail("not a raw iteration file");
+        file_ = static_cast<const unsigned char*>(data);
+
+        const RawHeader& h = header();
+        if (std::memcmp(h.magic, RAW_MAGIC, sizeof(RAW_MAGIC)) != 0) {
+            return fail("not a raw iteration file");
+        }
+        if (h.version != RAW_VERSION) return fail("unsupported version");
+        if (h.countBytes != 2 && h.countBytes != 4) return fail("bad count size");
+        size_t pixels = static_cast<size_t>(h.width) * h.height;
+        size_t needed = h.headerBytes + pixels * h.countBytes;
+        if (h.fractionOffset) needed = std::max(needed, h.fractionOffset + pixels * sizeof(float));
+        if (h.headerBytes < sizeof(RawHeader) || size_ < needed) return fail("file is truncated");
+        return true;
+    }
+
+    const char* error() const { return error_; }
+    const RawHeader& header() const { return *reinterpret_cast<const RawHeader*>(file_); }
+    int width() const { return static_cast<int>(header().width); }
+    int height() const { return static_cast<int>(header().height); }
+    int maxIterations() const { return static_cast<int>(header().maxIterations); }
+    bool hasFractions() const { return header().fractionOffset != 0; }
+
+    // The settings the file was rendered with (viewport, size, iterations).
+    RenderSettings settings() const {
+        RenderSettings s;
+        s.width = width();
+        s.height = height();
+        s.minReal = header().minReal;
+        s.maxReal = header().maxReal;
+        s.minImaginary = header().minImaginary;
+        s.maxImaginary = header().maxImaginary;
+        s.maxIterations = maxIterations();
+        return s;
+    }
+
+    // Direct pointers to the data; counts16() is null for 32-bit files and
+    // counts32() for 16-bit ones, fractions() when there are none.
+    const uint16_t* counts16() const {
+        return header().countBytes == 2 ? reinterpret_cast<const uint16_t*>(counts()) : nullptr;
+    }
+    const uint32_t* counts32() const {
+        return header().countBytes == 4 ? reinterpret_cast<const uint32_t*>(counts()) : nullptr;
+    }
+    const float* fractions() const {
+        return hasFractions() ? reinterpret_cast<const float*>(file_ + header().fractionOffset)
+                              : nullptr;
+    }
+
+    int count(int x, int y) const {
+        size_t i = static_cast<size_t>(y) * width() + x;
+        return header().countBytes == 2 ? counts16()[i] : static_cast<int>(counts32()[i]);
+    }
+
+    // count(x, y) plus its fractional part, if the file has one.
+    double smoothCount(int x, int y) const {
+        size_t i = static_cast<size_t>(y) * width() + x;
+        return count(x, y) + (hasFractions() ? fractions()[i] : 0.0f);
+    }
+
+private:
+    const unsigned char* counts() const { return file_ + header().headerBytes; }
+
+    bool fail(const char* reason) {
+        close();
+        error_ = reason;
+        return false;
+    }
+
+    void close() {
+        if (file_) munmap(const_cast<unsigned char*>(file_), size_);
+        file_ = nullptr;
+        size_ = 0;
+    }
+
+    const unsigned char* file_ = nullptr;
+    size_t size_ = 0;
+    const char* error_ = "";
+};
+
+// Prints the header of a raw iteration file and a summary of its counts, and
+// recolors it to a PNG if 'pngPath' is not empty.
+int showRawIterations(const std::string& path, const std::string& pngPath, int numThreads) {
+    RawIterationFile file;
+    if (!file.open(path)) {
+        std::cerr << "Cannot read " << path << ": " << file.error() << "\n";
+        return 1;
+    }
+    const RawHeader& header = file.header();
+    const int width = file.width();
+    const int height = file.height();
+    const int maxIterations = file.maxIterations();
+    std::cout << path << ": version " << header.version << ", " << width << "x" << height
+              << ", " << 8 * header.countBytes << "-bit counts"
+              << (file.hasFractions() ? " with fractions" : "") << "\n"
+              << "View: " << header.minReal << ".." << header.maxReal << " x "
+              << header.minImaginary << ".." << header.maxImaginary << "\n"
+              << "Max iterations: " << maxIterations << ", kernel: "
+              << std::string(header.kernel, strnlen(header.kernel, sizeof(header.kernel))) << "\n";
+
+    // Per-thread sums, added up once every row has been scanned.
+    struct Summary {
+        long long interior = 0;
+        long long escapedIterations = 0;
+        int maxEscaped = 0;
+    };
+    std::vector<Summary> partial(numThreads);
+    std::vector<unsigned char> image(pngPath.empty() ? 0 : static_cast<size_t>(width) * height);
+    parallelFor(height, numThreads, [&](int y, int workerId) {
+        Summary& summary = partial[workerId];
+        for (int x = 0; x < width; ++x) {
+            int count = file.count(x, y);
+            if (count >= maxIterations) {
+                ++summary.interior;
+            } else {
+                summary.escapedIterations += count;
+                summary.maxEscaped = std::max(summary.maxEscaped, count);
+            }
+            if (!image.empty()) {
+                image[static_cast<size_t>(y) * width + x] =
+                    static_cast<unsigned char>(mapIterationsToColor(count, maxIterations));
+            }
+        }
+    });
+    Summary total;
+    for (const Summary& summary : partial) {
+        total.interior += summary.interior;
+        total.escapedIterations += summary.escapedIterations;
+        total.maxEscaped = std::max(total.maxEscaped, summary.maxEscaped);
+    }
+    long long pixels = static_cast<long long>(width) * height;
+    long long escaped = pixels - total.interior;
+    std::cout << "Interior pixels: " << total.interior << " of " << pixels << "\n"
+              << "Escaped pixels: mean count "
+              << (escaped ? static_cast<double>(total.escapedIterations) / escaped : 0.0)
+              << ", highest " << total.maxEscaped << "\n";
+
+    if (!pngPath.empty()) {
+        if (!writePng(pngPath, image.data(), width, height, numThreads)) {
+            std::cerr << "Cannot write " << pngPath << "\n";
+            return 1;
+        }
+        std::cout << "Saved " << pngPath << "\n";
+    }
+    return 0;
+}
+
+// --- Julia set parameter sweep ---
+// Every point 'c' has its own Julia set: the starting points z whose orbit
+// under z = z^2 + c stays bounded. (The Mandelbrot set does the opposite: it
+// always starts at z = 0 and varies c.) A sweep renders a small thumbnail of
+// the Julia set of each c on a grid over the view and lays them out in one
+// atlas image, so you can see how the Julia sets change across the plane.
+//
+// Thumbnails are tiny, so if each were its own run the start-up work would
+// cost more than the rendering. Instead one run renders them all, SIMD_LANES
+// thumbnails at a time: a pixel has the same starting z in every thumbnail,
+// so the batch iterates it for SIMD_LANES values of c in lockstep, like the
+// "simd" kernel does for neighbouring pixels.
+
+// Every thumbnail shows -JULIA_EXTENT..JULIA_EXTENT on both axes; all Julia
+// sets of z^2 + c that are worth looking at fit in there.
+const double JULIA_EXTENT = 2.0;
+const int JULIA_THUMBNAIL_SIZE = 64;
+
+// One thumbnail of the atlas and what was measured while rendering it.
+struct JuliaCell {
+    int column, row;              // Position in the grid.
+    double cReal, cImaginary;     // The parameter c of this Julia set.
+    long long interior = 0;       // Pixels that never escaped.
+    long long iterations = 0;     // Iterations executed for this thumbnail.
+};
+
+// Renders the thumbnails of cells[0, lanes) (lanes <= SIMD_LANES), each
+// size x size pixels, into the atlas at column * size, row * size.
+void renderJuliaBatch(JuliaCell* cells, int lanes, int size, int maxIterations,
+                      unsigned char* atlas, size_t atlasWidth) {
+    double cReal[SIMD_LANES], cImaginary[SIMD_LANES];
+    for (int l = 0; l < SIMD_LANES; ++l) {
+        // Spare lanes in the last batch repeat its last thumbnail.
+        const JuliaCell& cell = cells[std::min(l, lanes - 1)];
+        cReal[l] = cell.cReal;
+        cImaginary[l] = cell.cImaginary;
+    }
+
+    const double step = 2.0 * JULIA_EXTENT / size;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            double zReal[SIMD_LANES], zImaginary[SIMD_LANES];
+            int count[SIMD_LANES];
+            for (int l = 0; l < SIMD_LANES; ++l) {
+                zReal[l] = -JULIA_EXTENT + x * step;
+                zImaginary[l] = JULIA_EXTENT - y * step;
+                count[l] = maxIterations;
+            }
+
+            for (int i = 0; i < maxIterations; ++i) {
+                bool allEscaped = true;
+                for (int l = 0; l < SIMD_LANES; ++l) {
+                    double zRealSquared = zReal[l] * zReal[l];
+                    double zImaginarySquared = zImaginary[l] * zImaginary[l];
+                    zImaginary[l] = 2.0 * zReal[l] * zImaginary[l] + cImaginary[l];
+                    zReal[l] = zRealSquared - zImaginarySquared + cReal[l];
+                    bool escaped = zReal[l] * zReal[l] + zImaginary[l] * zImaginary[l] > 4.0;
+                    count[l] = (escaped && count[l] == maxIterations) ? i : count[l];
+                    allEscaped = allEscaped && count[l] != maxIterations;
+                }
+                if (allEscaped) break;
+            }
+
+            for (int l = 0; l < lanes; ++l) {
+                JuliaCell& cell = cells[l];
+                size_t px = static_cast<size_t>(cell.column) * size + x;
+                size_t py = static_cast<size_t>(cell.row) * size + y;
+                atlas[py * atlasWidth + px] =
+                    static_cast<unsigned char>(mapIterationsToColor(count[l], maxIterations));
+                cell.iterations += iterationsExecuted(count[l], maxIterations);
+                if (count[l] == maxIterations) ++cell.interior;
+            }
+        }
+    }
+}
+
+// Renders a columns x rows atlas of Julia set thumbnails, one for the c at the
+// centre of each grid cell over the view in 'settings', and writes it to
+// 'path' (PNG) with an index of the cells next to it (.csv and .json).
+int renderJuliaSweep(const RenderSettings& settings, int columns, int rows, int size,
+                     int numThreads, const std::string& path) {
+    std::vector<JuliaCell> cells;
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            JuliaCell cell;
+            cell.column = column;
+            cell.row = row;
+            cell.cReal = settings.minReal +
+                         (column + 0.5) / columns * (settings.maxReal - settings.minReal);
+            cell.cImaginary = settings.maxImaginary -
+                              (row + 0.5) / rows * (settings.maxImaginary - settings.minImaginary);
+            cells.push_back(cell);
+        }
+    }
+
+    const size_t atlasWidth = static_cast<size_t>(columns) * size;
+    const size_t atlasHeight = static_cast<size_t>(rows) * size;
+    std::vector<unsigned char> atlas(atlasWidth * atlasHeight);
+    auto start = std::chrono::steady_clock::now();
+    int batches = static_cast<int>((cells.size() + SIMD_LANES - 1) / SIMD_LANES);
+    parallelFor(batches, numThreads, [&](int batch, int) {
+        size_t first = static_cast<size_t>(batch) * SIMD_LANES;
+        int lanes = static_cast<int>(std::min<size_t>(SIMD_LANES, cells.size() - first));
+        renderJuliaBatch(&cells[first], lanes, size, settings.maxIterations, atlas.data(),
+                         atlasWidth);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!writePng(path, atlas.data(), static_cast<int>(atlasWidth), static_cast<int>(atlasHeight),
+                  numThreads)) {
+        std::cerr << "Cannot write " << path << "\n";
+        return 1;
+    }
+
+    // The index sits next to the atlas: julia.png -> julia.csv and julia.json.
+    std::string prefix = path;
+    if (prefix.size() > 4 && prefix.compare(prefix.size() - 4, 4, ".png") == 0) {
+        prefix.resize(prefix.size() - 4);
+    }
+    const double pixels = static_cast<double>(size) * size;
+    std::ofstream csv(prefix + ".csv");
+    csv.precision(17);
+    csv << "column,row,x,y,c_real,c_imaginary,interior_fraction,iterations\n";
+    for (const JuliaCell& cell : cells) {
+        csv << cell.column << "," << cell.row << "," << cell.column * size << ","
+            << cell.row * size << "," << cell.cReal << "," << cell.cImaginary << ","
+            << cell.interior / pixels << "," << cell.iterations << "\n";
+    }
+
+    std::ofstream json(prefix + ".json");
+    json.precision(17);
+    json << "{\n  \"atlas\": \"" << path << "\",\n  \"columns\": " << columns
+         << ",\n  \"rows\": " << rows << ",\n  \"thumbnail_size\": " << size
+         << ",\n  \"julia_extent\": " << JULIA_EXTENT
+         << ",\n  \"max_iterations\": " << settings.maxIterations << ",\n  \"cells\": [\n";
+    for (size_t i = 0; i < cells.size(); ++i) {
+        const JuliaCell& cell = cells[i];
+        json << "    {\"column\": " << cell.column << ", \"row\": " << cell.row
+             << ", \"x\": " << cell.column * size << ", \"y\": " << cell.row * size
+             << ", \"c_real\": " << cell.cReal << ", \"c_imaginary\": " << cell.cImaginary
+             << ", \"interior_fraction\": " << cell.interior / pixels
+             << ", \"iterations\": " << cell.iterations << "}"
+             << (i + 1 < cells.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+    if (!csv || !json) {
+        std::cerr << "Cannot write the index " << prefix << ".csv/.json\n";
+        return 1;
+    }
+
+    std::cout << "Julia sweep: " << cells.size() << " thumbnails of " << size << "x" << size
+              << " in " << seconds << " s (" << cells.size() / seconds << " per second) -> "
+              << path << ", " << prefix << ".csv, " << prefix << ".json\n";
+    return 0;
+}
+
+// Returns the text after "--name=" if 'arg' is that option, or nullptr otherwise.
+const char* optionValue(const char* arg, const char* name) {
+    size_t length = std::strlen(name);
+    if (std::strncmp(arg, name, length) == 0 && arg[length] == '=') return arg + length + 1;
+    return nullptr;
+}
+
+// --- Self test ---
+// --self-test renders frames in two ways that must agree and reports each
+// comparison; the exit status is non-zero if any of them fails. It guards the
+// mistakes that never crash and only show up as wrong pixels.
+
+// The fixed-point kernels round differently from 'scalar', so a handful of
+// pixels right on an escape boundary may disagree. An overflow or a lost tile
+// garbles far more than this fraction of the frame.
+const double KERNEL_MISMATCH_TOLERANCE = 0.001;
+
+// Views for comparing kernels: the classic ones, and views far enough out
+// that z^2 exceeds the fixed-point range before the escape test.
+const BenchmarkView SELF_TEST_VIEWS[] = {
+    {"full_set", -2.0, 1.0, -1.5, 1.5},
+    {"seahorse_valley", -0.7600, -0.7400, 0.0950, 0.1100},
+    {"wide", -20.0, 20.0, -15.0, 15.0},
+    {"widest_fixed_point", -60.0, 60.0, -45.0, 45.0},
+};
+
+// Fraction of the pixels in which two frames differ.
+template<class T>
+double differingFraction(const FrameBuffer<T>& a, const FrameBuffer<T>& b) {
+    size_t differing = 0;
+    for (size_t i = 0; i < a.size(); ++i) differing += a[i] != b[i];
+    return a.size() ? static_cast<double>(differing) / a.size() : 0.0;
+}
+
+// Prints one line of the self-test report and returns 'passed'.
+bool reportCheck(const std::string& name, bool passed, double differing) {
+    std::printf("%-52s %-4s %8.4f%% of pixels differ\n", name.c_str(), passed ? "ok" : "FAIL",
+                differing * 100);
+    return passed;
+}
+
+// Reads an 8-bit binary PGM written by pgmHeader(). Returns false if 'path'
+// is missing or is not such a file.
+bool readPgm(const std::string& path, int& width, int& height, std::vector<unsigned char>& pixels) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    int maxValue = 0;
+    if (!(file >> magic >> width >> height >> maxValue) || magic != "P5" || maxValue != 255) {
+        return false;
+    }
+    file.get();
+    pixels.resize(static_cast<size_t>(width) * height);
+    file.read(reinterpret_cast<char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+    return static_cast<bool>(file);
+}
+
+int runSelfTest(int numThreads) {
+    bool allPassed = true;
+
+    // Every fixed-point kernel (and "auto", which picks one) against scalar.
+    const Kernel& reference = *findKernel("scalar");
+    for (const BenchmarkView& view : SELF_TEST_VIEWS) {
+        RenderSettings settings;
+        settings.width = 200;
+        settings.height = 150;
+        settings.minReal = view.minReal;
+        settings.maxReal = view.maxReal;
+        settings.minImaginary = view.minImaginary;
+        settings.maxImaginary = view.maxImaginary;
+        FrameBuffer<int> expected;
+        renderIterations(settings, reference, numThreads, expected);
+        for (const char* name : {"fixed64", "fixed128", "auto"}) {
+            FrameBuffer<int> actual;
+            renderIterations(settings, *findKernel(name), numThreads, actual);
+            double differing = differingFraction(expected, actual);
+            allPassed &= reportCheck(std::string("kernel/") + view.name + "/" + name,
+                                     differing <= KERNEL_MISMATCH_TOLERANCE, differing);
+        }
+    }
+
+    // A render resumed from a checkpoint cut off halfway (through a tile
+    // record, like a crash would) must match an uninterrupted one, with and
+    // without NUMA placement.
+    const std::string checkpointPath =
+        "/tmp/mandelbrot-selftest-" + std::to_string(getpid()) + ".ckpt";
+    for (bool numa : {false, true}) {
+        RenderSettings settings;
+        settings.width = 400;
+        settings.height = 300;
+        settings.numaPlacement = numa;
+        int threads = std::max(2, numThreads);
+        FrameBuffer<int> expected, resumed;
+        renderIterations(settings, reference, threads, expected);
+
+        unlink(checkpointPath.c_str());
+        Checkpoint first, second;
+        bool opened = first.open(checkpointPath, "self-test");
+        if (opened) {
+            FrameBuffer<int> interrupted;
+            renderIterations(settings, reference, threads, interrupted, nullptr, &first);
+            first.finish();
+            struct stat info;
+            opened = stat(checkpointPath.c_str(), &info) == 0 &&
+                     truncate(checkpointPath.c_str(), info.st_size / 2) == 0 &&
+                     second.open(checkpointPath, "self-test");
+        }
+        if (opened) renderIterations(settings, reference, threads, resumed, nullptr, &second);
+        double differing = opened ? differingFraction(expected, resumed) : 1.0;
+        allPassed &= reportCheck(std::string("checkpoint/resume/numa:") + (numa ? "on" : "off"),
+                                 opened && second.restoredTiles() > 0 && differing == 0, differing);
+    }
+    unlink(checkpointPath.c_str());
+
+    // A distributed render by three local worker processes must match the
+    // same rows rendered here. Run the self test of a -fsanitize=address build
+    // to also check the coordinator's bookkeeping as workers come and go.
+    {
+        RenderSettings settings;
+        settings.width = 400;
+        settings.height = 300;
+        settings.exploitSymmetry = false;
+        const std::string id = std::to_string(getpid());
+        const std::string outputPath = "/tmp/mandelbrot-selftest-" + id + ".pgm";
+        const std::string socketPath = "/tmp/mandelbrot-selftest-" + id + ".sock";
+        std::vector<unsigned char> expected(static_cast<size_t>(settings.width) * settings.height);
+        renderColorRows(settings, reference, false, 0, settings.height, numThreads, expected.data());
+
+        bool rendered = runCoordinator(settings, reference, false, 3, 1, outputPath, socketPath) == 0;
+        size_t headerSize = pgmHeader(settings.width, settings.height).size();
+        unsigned char* file = rendered ? mapSharedFile(outputPath, headerSize + expected.size()) : nullptr;
+        size_t differing = expected.size();
+        if (file) {
+            differing = 0;
+            for (size_t i = 0; i < expected.size(); ++i) differing += file[headerSize + i] != expected[i];
+            munmap(file, headerSize + expected.size());
+        }
+        double fraction = static_cast<double>(differing) / expected.size();
+        allPassed &= reportCheck("distributed/3_workers", file && differing == 0, fraction);
+        unlink(outputPath.c_str());
+    }
+
+    // A pyramid with an odd tile size must still have every level fully
+    // tiled, and its largest level must match the frame rendered in one go.
+    {
+        RenderSettings settings;
+        settings.width = 260;
+        settings.height = 195;
+        const std::string name = "/tmp/mandelbrot-selftest-" + std::to_string(getpid());
+        std::vector<unsigned char> expected(static_cast<size_t>(settings.width) * settings.height);
+        renderColorRows(settings, reference, false, 0, settings.height, numThreads, expected.data());
+
+        bool complete = renderPyramid(settings, reference, false, numThreads, name, 65,
+                                      64 * 1024 * 1024) == 0;
+        int maxLevel = 0;
+        while ((1 << maxLevel) < std::max(settings.width, settings.height)) ++maxLevel;
+        size_t differing = expected.size();
+        for (int level = maxLevel; level >= 0; --level) {
+            // Walk the tiles column by column and row by row until they run out.
+            int shift = maxLevel - level;
+            int levelWidth = (settings.width + (1 << shift) - 1) >> shift;
+            int levelHeight = (settings.height + (1 << shift) - 1) >> shift;
+            std::vector<unsigned char> image(static_cast<size_t>(levelWidth) * levelHeight);
+            std::string dir = name + "_files/" + std::to_string(level) + "/";
+            int y = 0;
+            for (int row = 0;; ++row) {
+                int x = 0, tileHeight = 0;
+                for (int column = 0;; ++column) {
+                    std::string path = dir + std::to_string(column) + "_" + std::to_string(row) + ".pgm";
+                    int tileWidth = 0;
+                    std::vector<unsigned char> tile;
+                    if (!readPgm(path, tileWidth, tileHeight, tile)) break;
+                    unlink(path.c_str());
+                    for (int ty = 0; ty < tileHeight && y + ty < levelHeight; ++ty) {
+                        for (int tx = 0; tx < tileWidth && x + tx < levelWidth; ++tx) {
+                            image[static_cast<size_t>(y + ty) * levelWidth + x + tx] =
+                                tile[static_cast<size_t>(ty) * tileWidth + tx];
+                        }
+                    }
+                    x += tileWidth;
+                }
+                if (x == 0) break;
+                complete &= x == levelWidth;
+                y += tileHeight;
+            }
+            complete &= y == levelHeight;
+            rmdir(dir.c_str());
+            if (level == maxLevel) {
+                differing = 0;
+                for (size_t i = 0; i < expected.size(); ++i) differing += image[i] != expected[i];
+            }
+        }
+        rmdir((name + "_files").c_str());
+        unlink((name + ".dzi").c_str());
+        double fraction = static_cast<double>(differing) / expected.size();
+        allPassed &= reportCheck("pyramid/odd_tile_size", complete && differing == 0, fraction);
+    }
+
+    std::printf("%s\n", allPassed ? "All checks passed" : "Some checks FAILED");
+    return allPassed ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    // Command-line options. With no options we render the classic view.
+    bool benchmark = false;
+    bool selfTest = false;
+    std::string benchmarkFilter;
+    std::string benchmarkOut;
+    double benchmarkMinTime = 0.5;
+    const Kernel* kernel = &KERNELS[0];
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    bool distanceMode = false;
+    int distributedWorkers = 0;
+    std::string workerSocket;
+    std::string outputPath = "mandelbrot.pgm";
+    std::string socketPath = "/tmp/mandelbrot-" + std::to_string(getpid()) + ".sock";
+    std::string pngPath;
+    std::string tileStatsPrefix;
+    std::string pyramidName;
+    long long buddhabrotSamples = 0;
+    BuddhabrotSampler buddhabrotSampler = BuddhabrotSampler::Metropolis;
+    int buddhabrotSnapshots = 1;
+    int pyramidTileSize = 256;
+    size_t memoryBudgetMB = 1024;
+    std::string rawPath;
+    std::string rawInfoPath;
+    bool rawFractions = false;
+    long long quadtreeBudget = 0;
+    std::string checkpointPath;
+    int juliaColumns = 0;
+    int juliaRows = 0;
+    int juliaThumbnailSize = JULIA_THUMBNAIL_SIZE;
+    const char* numaMode = "auto";
+    RenderSettings settings;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* value = nullptr;
+        if (std::strcmp(argv[i], "--benchmark") == 0) {
+            benchmark = true;
+        } else if (std::strcmp(argv[i], "--self-test") == 0) {
+            selfTest = true;
+        } else if ((value = optionValue(argv[i], "--benchmark_filter"))) {
+            benchmarkFilter = value;
+        } else if ((value = optionValue(argv[i], "--benchmark_min_time"))) {
+            benchmarkMinTime = std::atof(value);
+        } else if ((value = optionValue(argv[i], "--benchmark_out"))) {
+            benchmarkOut = value;
+        } else if ((value = optionValue(argv[i], "--kernel"))) {
+            kernel = findKernel(value);
+            if (!kernel) {
+                std::cerr << "Unknown kernel: " << value << "\n";
+                return 1;
+            }
+        } else if ((value = optionValue(argv[i], "--threads"))) {
+            numThreads = std::max(1, std::atoi(value));
+        } else if ((value = optionValue(argv[i], "--size"))) {
+            if (std::sscanf(value, "%dx%d", &settings.width, &settings.height) != 2 ||
+                settings.width <= 0 || settings.height <= 0) {
+                std::cerr << "Bad size: " << value << "\n";
+                return 1;
+            }
+        } else if ((value = optionValue(argv[i], "--view"))) {
+            if (std::sscanf(value, "%lf,%lf,%lf,%lf", &settings.minReal, &settings.maxReal,
+                            &settings.minImaginary, &settings.maxImaginary) != 4) {
+                std::cerr << "Bad view: " << value << "\n";
+                return 1;
+            }
+        } else if ((value = optionValue(argv[i], "--max-iterations"))) {
+            settings.maxIterations = std::max(1, std::atoi(value));
+        } else if ((value = optionValue(argv[i], "--distributed"))) {
+            distributedWorkers = std::max(0, std::atoi(value));
+        } else if ((value = optionValue(argv[i], "--worker"))) {
+            workerSocket = value;
+        } else if ((value = optionValue(argv[i], "--png"))) {
+            pngPath = value;
+        } else if ((value = optionValue(argv[i], "--tile-stats"))) {
+            tileStatsPrefix = value;
+        } else if ((value = optionValue(argv[i], "--buddhabrot"))) {
+            buddhabrotSamples = std::max(1LL, std::atoll(value));
+        } else if ((value = optionValue(argv[i], "--sampler"))) {
+            if (std::strcmp(value, "uniform") == 0) {
+                buddhabrotSampler = BuddhabrotSampler::Uniform;
+            } else if (std::strcmp(value, "metropolis") == 0) {
+                buddhabrotSampler = BuddhabrotSampler::Metropolis;
+            } else {
+                std::cerr << "Unknown sampler: " << value << "\n";
+                return 1;
+            }
+        } else if ((value = optionValue(argv[i], "--snapshots"))) {
+            buddhabrotSnapshots = std::max(1, std::atoi(value));
+        } else if ((value = optionValue(argv[i], "--raw"))) {
+            rawPath = value;
+        } else if (std::strcmp(argv[i], "--raw-smooth") == 0) {
+            rawFractions = true;
+        } else if ((value = optionValue(argv[i], "--raw-info"))) {
+            rawInfoPath = value;
+        } else if ((value = optionValue(argv[i], "--checkpoint"))) {
+            checkpointPath = value;
+        } else if ((value = optionValue(argv[i], "--quadtree"))) {
+            quadtreeBudget = std::max(1LL, std::atoll(value));
+        } else if ((value = optionValue(argv[i], "--julia-sweep"))) {
+            if (std::sscanf(value, "%dx%d", &juliaColumns, &juliaRows) != 2 || juliaColumns <= 0 ||
+                juliaRows <= 0) {
+                std::cerr << "Bad Julia grid: " << value << "\n";
+                return 1;
+            }
+        } else if ((value = optionValue(argv[i], "--thumbnail"))) {
+            juliaThumbnailSize = std::max(1, std::atoi(value));
+        } else if ((value = optionValue(argv[i], "--pyramid"))) {
+            pyramidName = value;
+        } else if ((value = optionValue(argv[i], "--tile-size"))) {
+            pyramidTileSize = std::max(MIN_PYRAMID_TILE_SIZE, std::atoi(value));
+        } else if ((value = optionValue(argv[i], "--memory-budget"))) {
+            memoryBudgetMB = static_cast<size_t>(std::max(1, std::atoi(value)));
+        } else if ((value = optionValue(argv[i], "--output"))) {
+            outputPath = value;
+        } else if ((value = optionValue(argv[i], "--socket"))) {
+            socketPath = value;
+        } else if (std::strcmp(argv[i], "--no-symmetry") == 0) {
+            settings.exploitSymmetry = false;
+        } else if ((value = optionValue(argv[i], "--schedule"))) {
+            if (std::strcmp(value, "uniform") == 0) {
+                settings.schedule = Schedule::Uniform;
+            } else if (std::strcmp(value, "predictive") == 0) {
+                settings.schedule = Schedule::Predictive;
+            } else {
+                std::cerr << "Unknown schedule: " << value << "\n";
+                return 1;
+            }
+        } else if ((value = optionValue(argv[i], "--huge-pages"))) {
+            if (std::strcmp(value, "off") == 0) {
+                settings.hugePages = HugePages::Off;
+            } else if (std::strcmp(value, "transparent") == 0) {
+                settings.hugePages = HugePages::Transparent;
+            } else if (std::strcmp(value, "explicit") == 0) {
+                settings.hugePages = HugePages::Explicit;
+            } else {
+                std::cerr << "Unknown huge page mode: " << value << "\n";
+                return 1;
+            }
+        } else if ((value = optionValue(argv[i], "--numa"))) {
+            if (std::strcmp(value, "auto") != 0 && std::strcmp(value, "on") != 0 &&
+                std::strcmp(value, "off") != 0) {
+                std::cerr << "Unknown NUMA mode: " << value << "\n";
+                return 1;
+            }
+            numaMode = value;
+        } else if ((value = optionValue(argv[i], "--mode"))) {
+            if (std::strcmp(value, "distance") == 0) {
+                distanceMode = true;
+            } else if (std::strcmp(value, "escape") != 0) {
+                std::cerr << "Unknown mode: " << value << "\n";
+                return 1;
+            }
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    // Pinning threads only pays off when there is more than one memory node.
+    if (std::strcmp(numaMode, "auto") == 0) {
+        settings.numaPlacement = numaNodeCpus().size() > 1;
+    } else {
+        settings.numaPlacement = std::strcmp(numaMode, "on") == 0;
+    }
+
+    if (benchmark) {
+        return runBenchmarks(benchmarkFilter, benchmarkMinTime, benchmarkOut, settings);
+    }
+    if (selfTest) {
+        return runSelfTest(numThreads);
+    }
+
+    if (!workerSocket.empty()) {
+        return runWorker(workerSocket, numThreads);
+    }
+    if (distributedWorkers > 0) {
+        // Each local worker process renders its bands on a single thread.
+        return runCoordinator(settings, *kernel, distanceMode, distributedWorkers, 1, outputPath,
+                              socketPath);
+    }
+
+    if (!rawInfoPath.empty()) {
+        return showRawIterations(rawInfoPath, pngPath, numThreads);
+    }
+    if (juliaColumns > 0) {
+        return renderJuliaSweep(settings, juliaColumns, juliaRows, juliaThumbnailSize, numThreads,
+                                pngPath.empty() ? "julia.png" : pngPath);
+    }
+    if (buddhabrotSamples > 0) {
+        return renderBuddhabrot(settings, buddhabrotSampler, numThreads, buddhabrotSamples,
+                                buddhabrotSnapshots, pngPath.empty() ? "buddhabrot.png" : pngPath);
+    }
+    if (quadtreeBudget > 0 && (distanceMode || rawFractions || !tileStatsPrefix.empty())) {
+        std::cerr << "--quadtree renders escape counts only, without tile stats or fractions\n";
+        return 1;
+    }
+    if (!checkpointPath.empty() && (quadtreeBudget > 0 || rawFractions)) {
+        std::cerr << "--checkpoint works with plain escape-time and distance renders only\n";
+        return 1;
+    }
+    if (distanceMode && !rawPath.empty()) {
+        std::cerr << "--raw stores iteration counts and needs --mode=escape\n";
+        return 1;
+    }
+    if (!pyramidName.empty()) {
+        return renderPyramid(settings, *kernel, distanceMode, numThreads, pyramidName,
+                             pyramidTileSize, memoryBudgetMB * 1024 * 1024);
+    }
+
+    const int width = settings.width;
+    const int height = settings.height;
+
+    // This buffer will hold our pixel data, one grayscale intensity per pixel,
+    // stored row after row in a single block of memory.
+    FrameBuffer<unsigned char> imageData;
+
+    // Per-tile cost counters, only collected when --tile-stats is given.
+    std::vector<TileStats> tileStats;
+    std::vector<TileStats>* stats = tileStatsPrefix.empty() ? nullptr : &tileStats;
+
+    // With --checkpoint, finished tiles are saved as they complete, and a
+    // rerun of the same command picks up where an interrupted one stopped.
+    // The signature ties the file to this exact render.
+    Checkpoint checkpointFile;
+    Checkpoint* checkpoint = nullptr;
+    if (!checkpointPath.empty()) {
+        std::ostringstream signature;
+        signature.precision(17);
+        signature << settings.width << " " << settings.height << " " << settings.minReal << " "
+                  << settings.maxReal << " " << settings.minImaginary << " "
+                  << settings.maxImaginary << " " << settings.maxIterations << " " << kernel->name
+                  << " " << (distanceMode ? "distance" : "escape") << " "
+                  << settings.exploitSymmetry;
+        if (!checkpointFile.open(checkpointPath, signature.str())) {
+            std::cerr << "Cannot use checkpoint " << checkpointPath << ": " << checkpointFile.error()
+                      << "\n";
+            return 1;
+        }
+        checkpoint = &checkpointFile;
+    }
+
+    if (distanceMode) {
+        // Distance mode: estimate how far each pixel is from the set's boundary
+        // and shade by that distance measured in pixels.
+        FrameBuffer<double> distances;
+        renderDistances(settings, *kernel, numThreads, distances, stats, checkpoint);
+        double pixelSize = (settings.maxReal - settings.minReal) / settings.width;
+        mapToImage(settings, numThreads, distances, imageData,
+                   [&](double distance) { return mapDistanceToColor(distance, pixelSize); });
+    } else {
+        // 1. & 2. Map every pixel to a point 'c' in the complex plane and calculate
+        // how many iterations it takes to escape. renderIterations() splits the
+        // image into tiles and spreads them over numThreads threads.
+        FrameBuffer<int> iterations;
+        FrameBuffer<float> fractions;
+        if (quadtreeBudget > 0) {
+            QuadtreeStats quadtree;
+            renderQuadtree(settings, *kernel, numThreads, quadtreeBudget, iterations, quadtree);
+            std::cout << "Quadtree: " << quadtree.nodes << " nodes, " << quadtree.leaves
+                      << " leaves, depth " << quadtree.maxDepth << ", " << quadtree.evaluated
+                      << " pixels computed ("
+                      << 100.0 * quadtree.evaluated / (static_cast<double>(width) * height)
+                      << "%) in " << quadtree.seconds << " s\n";
+        } else if (rawFractions) {
+            renderSmoothIterations(settings, numThreads, iterations, fractions, stats);
+        } else {
+            renderIterations(settings, *kernel, numThreads, iterations, stats, checkpoint);
+        }
+        if (!rawPath.empty() &&
+            !writeRawIterations(rawPath, settings, rawFractions ? "scalar" : kernel->name,
+                                iterations, rawFractions ? &fractions : nullptr, numThreads)) {
+            std::cerr << "Cannot write " << rawPath << "\n";
+            return 1;
+        }
+
+        // 3. Map each iteration count to a grayscale color and store it in our image data.
+        mapToImage(settings, numThreads, iterations, imageData, [&](int count) {
+            return mapIterationsToColor(count, settings.maxIterations);
+        });
+    }
+
+    if (checkpoint) {
+        if (!checkpoint->finish()) {
+            std::cerr << "Cannot write checkpoint " << checkpointPath << "\n";
+            return 1;
+        }
+        if (checkpoint->restoredTiles() > 0) {
+            std::cout << "Resumed " << checkpoint->restoredTiles() << " tiles from "
+                      << checkpointPath << "\n";
+        }
+    }
+
+    if (stats && !writeTileStats(tileStatsPrefix, settings, tileStats, numThreads)) {
+        std::cerr << "Cannot write tile stats to " << tileStatsPrefix << "\n";
+        return 1;
+    }
+
+    // --- Example Usage: Outputting the image data ---
+    // For a real application, you'd save this data to an image file (like PPM, PNG).
+    // Here, we'll just print a small portion or a simplified representation to the console.
+    // This demonstrates that we have computed the data.
+
+    std::cout << "Mandelbrot set visualization data generated.\n";
+    std::cout << "Image dimensions: " << width << "x" << height << "\n";
+    std::cout << "Max iterations: " << settings.maxIterations << "\n";
+    std::cout << "\nDisplaying a small preview (first 10x10 pixels):\n";
+
+    for (int y = 0; y < std::min(10, height); ++y) {
+        for (int x = 0; x < std::min(10, width); ++x) {
+            // Print a character based on the color intensity.
+            // '#' for darker areas, '.' for brighter areas.
+            int color = imageData[static_cast<size_t>(y) * width + x];
+            if (color < 50) std::cout << "#"; // Darker, likely in or near the set
+            else if (color < 150) std::cout << "*";
+            else std::cout << "."; // Brighter, escaped quickly
+        }
+        std::cout << "\n";
+    }
+    std::cout << "\n'#' represents points likely inside the Mandelbrot set.\n";
+    std::cout << "'.' represents points that escaped quickly.\n";
+
+    // To actually see the fractal, write 'imageData' to a file format that an
+    // image viewer can open. With --png=FILE.png we encode it as a PNG.
+    if (!pngPath.empty()) {
+        if (!writePng(pngPath, imageData.data(), width, height, numThreads)) {
+            std::cerr << "Cannot write " << pngPath << "\n";
+            return 1;
+        }
+        std::cout << "Saved " << pngPath << "\n";
+    }
+
+    return 0;
+}
@@ -1,58 +1,581 @@
 // Learning Objective: Understand how to build a basic C++ thread pool to efficiently
 // manage and execute concurrent tasks using std::thread, std::mutex, and
 // std::condition_variable for synchronization and task distribution.
+// On top of the pool we then build data-parallel loops (parallel_for,
+// parallel_reduce, parallel_transform) in which the calling thread helps out,
+// and a TaskGraph that runs tasks with dependencies between them.
 
 #include <vector>                  // For std::vector to hold worker threads
-#include <queue>                   // For std::queue to hold tasks
 #include <thread>                  // For std::thread to create worker threads
 #include <mutex>                   // For std::mutex to protect shared data
 #include <condition_variable>      // For std::condition_variable to signal workers
 #include <functional>              // For std::function to store arbitrary tasks
 #include <iostream>                // For example output (std::cout)
 #include <stdexcept>               // For std::runtime_error
+#include <cstdio>                  // For std::sscanf
+#include <string>                  // For task names in the example
+#include <atomic>                  // For handing out loop chunks without a lock
+#include <memory>                  // For std::shared_ptr to share loop state with helpers
+#include <exception>               // For passing exceptions from helpers to the caller
+#include <algorithm>               // For std::min, std::max, std::sort and the task heap
+#include <chrono>                  // For std::chrono::milliseconds in the example
+#include <deque>                   // For the nodes of a TaskGraph
+#include <initializer_list>        // For listing a node's predecessors
+#include <fstream>                 // For reading the CPU topology from /sys
+#include <sstream>                 // For parsing CPU lists such as "0-3,8-11"
+#include <map>                     // For grouping CPUs by core and socket
+#include <pthread.h>               // For pinning worker threads (pthread_setaffinity_np)
+#include <sched.h>                 // For the set of CPUs we may run on
+#include <cstdint>                 // For the 64-bit metric counters
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>             // For __rdtsc, the tracer's clock
+#endif
+
+// How parallel_for and friends cut a range [begin, end) into chunks.
+enum class Partition {
+    Static,  // One equal block per participant. Cheapest, best for uniform work.
+    Dynamic, // Chunks of 'grain' indices handed out one by one. Balances uneven work.
+    Guided,  // Big chunks first, shrinking towards 'grain' as the range runs out.
+};
+
+// Priority lanes for ThreadPool::enqueue. Each lane has a latency target: a
+// task is due that long after it was enqueued, and workers always take the task
+// that is due first. So High tasks jump ahead of waiting Normal and Low tasks,
+// but a Low task that has waited LOW_LANE_TARGET eventually becomes due before
+// fresh High work arrives - nothing starves. A task can also be given an
+// explicit deadline (earliest-deadline-first), which replaces its lane's target.
+enum class Priority {
+    High,   // Interactive requests: run as soon as a worker is free.
+    Normal, // The default.
+    Low,    // Background and batch work.
+};
+const std::chrono::milliseconds HIGH_LANE_TARGET(0);
+const std::chrono::milliseconds NORMAL_LANE_TARGET(100);
+const std::chrono::milliseconds LOW_LANE_TARGET(1000);
+
+// --- CPU topology ---
+// A modern server has several sockets (packages), each with its own memory
+// (a NUMA node), each holding many cores, and each core may run two hardware
+// threads (SMT siblings) that share its L1 and L2 caches. Where the workers run
+// matters: two workers on SMT siblings share a core's caches, workers on
+// different sockets do not even share the L3 and pay extra for each other's memory.
+
+// How ThreadPool places its workers on CPUs.
+enum class Placement {
+    None,    // Do not pin; the kernel may move workers around.
+    Compact, // Fill SMT siblings, then cores, then sockets: workers share caches.
+    Scatter, // One worker per core, alternating sockets, SMT siblings last:
+             // every worker gets as much cache and memory bandwidth as possible.
+};
+
+// One logical CPU as Linux describes it under /sys/devices/system.
+struct CpuTopology {
+    int cpu = 0;
+    int core = 0;    // core_id, unique within a package.
+    int package = 0; // Socket.
+    int node = 0;    // NUMA node.
+};
+
+// Parses a Linux CPU list such as "0-3,8-11".
+std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream list(text);
+    std::string range;
+    while (std::getline(list, range, ',')) {
+        int first = 0, last = 0;
+        int fields = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (fields < 1) continue;
+        if (fields == 1) last = first;
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Reads one integer from a /sys file, or returns 'fallback'.
+int read_sys_int(const std::string& path, int fallback) {
+    std::ifstream file(path);
+    int value;
+    return file >> value ? value : fallback;
+}
+
+// Returns the CPUs this process may run on with their core, socket and NUMA
+// node. Without /sys (not Linux) every CPU counts as its own core on socket 0.
+std::vector<CpuTopology> read_cpu_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return {};
+
+    std::map<int, int> node_of_cpu;
+    for (int node = 0;; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file) break;
+        std::string text;
+        std::getline(file, text);
+        for (int cpu : parse_cpu_list(text)) node_of_cpu[cpu] = node;
+    }
+
+    std::vector<CpuTopology> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        CpuTopology info;
+        info.cpu = cpu;
+        info.core = read_sys_int(topology + "core_id", cpu);
+        info.package = read_sys_int(topology + "physical_package_id", 0);
+        info.node = node_of_cpu.count(cpu) ? node_of_cpu[cpu] : 0;
+        cpus.push_back(info);
+    }
+    return cpus;
+}
+
+// Orders the CPUs for 'placement': worker i goes on the i-th CPU (wrapping
+// around if there are more workers than CPUs).
+std::vector<CpuTopology> order_cpus(std::vector<CpuTopology> cpus, Placement placement) {
+    if (placement == Placement::Compact) {
+        std::sort(cpus.begin(), cpus.end(), [](const CpuTopology& a, const CpuTopology& b) {
+            if (a.node != b.node) return a.node < b.node;
+            if (a.package != b.package) return a.package < b.package;
+            if (a.core != b.core) return a.core < b.core;
+            return a.cpu < b.cpu;
+        });
+    } else if (placement == Placement::Scatter) {
+        // Rank each CPU among its core's siblings and each core within its socket,
+        // then take the first sibling of core 0 on every socket, then of core 1, ...
+        std::map<std::pair<int, int>, int> siblings_seen;     // (package, core) -> count
+        std::map<std::pair<int, int>, int> core_rank;         // (package, core) -> rank
+        std::map<int, int> cores_seen;                        // package -> count
+        std::sort(cpus.begin(), cpus.end(), [](const CpuTopology& a, const CpuTopology& b) {
+            return a.cpu < b.cpu;
+        });
+        std::vector<std::pair<std::vector<int>, CpuTopology>> keyed;
+        for (const CpuTopology& cpu : cpus) {
+            std::pair<int, int> core(cpu.package, cpu.core);
+            if (!core_rank.count(core)) core_rank[core] = cores_seen[cpu.package]++;
+            int sibling = siblings_seen[core]++;
+            keyed.push_back({{sibling, core_rank[core], cpu.package}, cpu});
+        }
+        std::stable_sort(keyed.begin(), keyed.end(),
+                         [](const std::pair<std::vector<int>, CpuTopology>& a,
+                            const std::pair<std::vector<int>, CpuTopology>& b) {
+                             return a.first < b.first;
+                         });
+        for (size_t i = 0; i < keyed.size(); ++i) cpus[i] = keyed[i].second;
+    }
+    return cpus;
+}
+
+// --- Idle workers ---
+// A worker with nothing to do can park (sleep on the condition variable) or
+// keep looking. Parking is cheap for the machine but expensive for the next
+// task: waking a parked thread costs a futex system call and a context switch,
+// tens of microseconds. So an idle worker first spins for a while, checking the
+// queue without taking the lock, then yields its CPU a few times, and only then
+// parks. A short burst of tasks is picked up by a worker that is still spinning.
+//
+// The pool counts its spinning and parked workers (a simple eventcount).
+// enqueue only calls notify_one when nobody is spinning and someone is parked;
+// a spinning worker will see the task anyway. A worker that stops spinning
+// registers as parked before it stops counting as spinning, and checks the
+// queue once more under the lock before it sleeps, so no task is ever missed.
+
+struct IdlePolicy {
+    unsigned spins = 2000; // Checks of the queue with a CPU 'pause' in between.
+    unsigned yields = 10;  // Then checks with std::this_thread::yield in between.
+};
+
+// Tells the CPU we are in a spin loop: saves power and frees the core for its
+// SMT sibling.
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// --- Elastic pools ---
+// A pool sized for the peak wastes threads (and their stacks) the rest of the
+// time; a pool sized for the average falls behind at the peak, or when tasks
+// block on I/O. An elastic pool runs between min_threads and max_threads
+// workers. A supervisor thread looks at the task due next in each queue: if one
+// has waited longer than grow_after and no worker is idle, it starts another
+// worker. A worker that has been parked for idle_timeout retires, as long as
+// more than min_threads are left. Neither needs the pool to stop.
+//
+// A task that blocks (sleeps, waits for the disk) holds on to its worker
+// without using the CPU. Wrapping the blocking call in a blocking_region tells
+// the pool: while it lasts, a spare worker takes over, so CPU work queued behind
+// it keeps running. When the region ends the pool has one worker too many; the
+// first one to come back for a task parks as a spare for the next region, and
+// retires if none comes within idle_timeout. At most blocking_spares workers
+// are added this way, on top of max_threads.
+
+struct ElasticLimits {
+    size_t min_threads = 1;
+    size_t max_threads = 1;
+    std::chrono::milliseconds grow_after{10};    // Queue wait that makes the pool grow.
+    std::chrono::milliseconds idle_timeout{5000}; // Parked time after which a worker retires.
+    size_t blocking_spares = 4;                   // Extra workers for tasks in a blocking_region.
+};
+
+// --- Metrics ---
+// To size a pool and pick a task granularity we need to know how long tasks
+// wait in the queue, how long they run, and how often workers steal, park and
+// get woken. Each worker keeps its own counters, written only by itself, so
+// recording needs no lock and no atomic read-modify-write: a relaxed load and
+// store. Anyone can read them at any time for a snapshot.
+//
+// Latencies go into histograms with log-linear buckets, as in HdrHistogram:
+// every power of two is split into 8 buckets, so any value is known to within
+// 12.5% while a handful of buckets cover nanoseconds to minutes.
+
+// Adds to a counter that only the calling thread writes.
+inline void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+// What a LatencyHistogram held at one moment. Values are in nanoseconds.
+struct HistogramSnapshot {
+    std::vector<std::uint64_t> counts; // Per bucket, see LatencyHistogram::bucket_floor.
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+
+    double mean() const { return count ? static_cast<double>(sum) / count : 0; }
+
+    // Upper end of the bucket holding the 'quantile' (0 to 1) of all values.
+    std::uint64_t percentile(double quantile) const;
+};
+
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 3;  // 8 buckets per power of two.
+    static const int MAX_EXPONENT = 40;    // Up to 2^40 ns (18 minutes); longer lands in the last bucket.
+    static const size_t BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    // Records one value. Only one thread may record into a histogram.
+    void record(std::uint64_t nanoseconds) {
+        bump(counts[bucket_of(nanoseconds)]);
+        bump(count);
+        bump(sum, nanoseconds);
+    }
+
+    HistogramSnapshot snapshot() const {
+        HistogramSnapshot result;
+        result.counts.resize(BUCKETS);
+        for (size_t b = 0; b < BUCKETS; ++b) result.counts[b] = counts[b].load(std::memory_order_relaxed);
+        result.count = count.load(std::memory_order_relaxed);
+        result.sum = sum.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    static size_t bucket_of(std::uint64_t value) {
+        const std::uint64_t sub_buckets = 1 << SUB_BUCKET_BITS;
+        if (value < sub_buckets) return static_cast<size_t>(value); // Small values are exact.
+        int exponent = 63 - __builtin_clzll(value);
+        if (exponent >= MAX_EXPONENT) return BUCKETS - 1;
+        std::uint64_t sub = (value >> (exponent - SUB_BUCKET_BITS)) & (sub_buckets - 1);
+        return static_cast<size_t>(((exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + sub);
+    }
+
+    // Smallest value that lands in 'bucket'.
+    static std::uint64_t bucket_floor(size_t bucket) {
+        const size_t sub_buckets = 1 << SUB_BUCKET_BITS;
+        if (bucket < sub_buckets) return bucket;
+        int exponent = static_cast<int>(bucket >> SUB_BUCKET_BITS) - 1 + SUB_BUCKET_BITS;
+        std::uint64_t sub = bucket & (sub_buckets - 1);
+        return (sub_buckets + sub) << (exponent - SUB_BUCKET_BITS);
+    }
+
+private:
+    std::atomic<std::uint64_t> counts[BUCKETS] = {};
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> sum{0};
+};
+
+std::uint64_t HistogramSnapshot::percentile(double quantile) const {
+    if (count == 0) return 0;
+    std::uint64_t rank = static_cast<std::uint64_t>(quantile * (count - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); ++b) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return b + 1 < LatencyHistogram::BUCKETS ? LatencyHistogram::bucket_floor(b + 1) - 1
+                                                     : LatencyHistogram::bucket_floor(b);
+        }
+    }
+    return LatencyHistogram::bucket_floor(counts.size() - 1);
+}
+
+// Counters of one worker, on their own cache lines so that workers do not
+// slow each other down by writing next to each other (false sharing).
+struct alignas(64) WorkerMetrics {
+    std::atomic<std::uint64_t> tasks{0};
+    std::atomic<std::uint64_t> steals{0};  // Tasks taken from another node's queue.
+    std::atomic<std::uint64_t> parks{0};   // Times the worker gave up spinning and parked.
+    std::atomic<std::uint64_t> wakeups{0}; // Times it was woken from a park to run a task.
+    LatencyHistogram queue_wait;           // From enqueue to the start of the task.
+    LatencyHistogram execution;            // Run time of the task.
+};
+
+// --- Tracing ---
+// Averages hide stragglers and convoys; a timeline shows them. A TaskTracer
+// records what happens to each task - enqueued, stolen, started, finished - and
+// writes it as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev
+// show as one track per thread, with an arrow from each enqueue to its task.
+//
+// Recording has to be cheap enough to leave on under load. Every thread writes
+// to its own ring buffer, so there is no lock and no shared cache line; the
+// time is the CPU's time stamp counter (rdtsc, a few nanoseconds, no system
+// call), converted to microseconds only when the trace is written. A full ring
+// overwrites its oldest events. The counter must tick at a constant rate on all
+// CPUs, which it does on x86 processors of the last decade ("invariant TSC").
+
+// Ticks of the time stamp counter, or nanoseconds where there is none.
+inline std::uint64_t read_timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+enum class TraceEvent : std::uint8_t {
+    Enqueue, // A thread put the task in a queue.
+    Steal,   // A worker took it from another NUMA node's queue.
+    Begin,   // A worker started running it.
+    End,     // ... and finished.
+};
+
+class TaskTracer {
+public:
+    // Starts recording. A thread's ring is made the first time it records and
+    // holds the last 'events_per_thread' events (rounded up to a power of two).
+    // Events from an earlier start are dropped.
+    void start(size_t events_per_thread) {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        capacity = 1;
+        while (capacity < events_per_thread) capacity *= 2;
+        for (std::unique_ptr<Ring>& ring : rings) ring->first.store(ring->head.load());
+        start_ticks = read_timestamp();
+        start_time = std::chrono::steady_clock::now();
+        on.store(true);
+    }
+
+    // Stops recording. Events already in the rings stay there for write.
+    void stop() { on.store(false); }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    // Adds an event to the calling thread's ring. 'worker' names the thread's
+    // track in the trace (-1 for threads outside the pool).
+    void record(TraceEvent event, std::uint64_t task, Priority priority, int worker) {
+        Ring* ring = cached_tracer == id ? cached_ring : ring_for_thread(worker);
+        std::uint64_t head = ring->head.load(std::memory_order_relaxed);
+        Slot& slot = ring->slots[head & ring->mask];
+        slot.ticks.store(read_timestamp(), std::memory_order_relaxed);
+        slot.what.store(task << 8 | static_cast<std::uint64_t>(priority) << 4 |
+                        static_cast<std::uint64_t>(event), std::memory_order_relaxed);
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    // Writes the recorded events to 'path' as Chrome trace JSON. Threads may
+    // keep recording meanwhile; events overwritten while we read are left out.
+    // Returns false if the file cannot be written.
+    bool write(const std::string& path) {
+        std::ofstream out(path);
+        if (!out) return false;
+        std::lock_guard<std::mutex> lock(rings_mutex);
+
+        // How many ticks make a microsecond, measured over the whole recording.
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start_time;
+        double ticks_per_us = elapsed.count() > 0 ? (read_timestamp() - start_ticks) / elapsed.count() : 1000;
+        if (ticks_per_us <= 0) ticks_per_us = 1000;
+
+        static const char* const priority_names[] = {"high", "normal", "low"};
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        const char* separator = "";
+        for (size_t t = 0; t < rings.size(); ++t) {
+            Ring& ring = *rings[t];
+            out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+                << ",\"args\":{\"name\":\""
+                << (ring.worker >= 0 ? "worker " + std::to_string(ring.worker) : "thread " + std::to_string(t))
+                << "\"}}";
+            separator = ",\n";
+
+            std::uint64_t head = ring.head.load(std::memory_order_acquire);
+            std::uint64_t capacity_of_ring = ring.mask + 1;
+            std::uint64_t from = std::max(ring.first.load(), head > capacity_of_ring ? head - capacity_of_ring : 0);
+            std::vector<std::pair<std::uint64_t, std::uint64_t>> events; // (ticks, what)
+            for (std::uint64_t i = from; i < head; ++i) {
+                const Slot& slot = ring.slots[i & ring.mask];
+                events.emplace_back(slot.ticks.load(std::memory_order_relaxed),
+                                    slot.what.load(std::memory_order_relaxed));
+            }
+            // A writer that has moved on by a whole ring since we read 'head' may
+            // have overwritten the oldest of them, even the one it is writing now.
+            std::uint64_t head_after = ring.head.load(std::memory_order_acquire);
+            for (std::uint64_t i = from; i < head; ++i) {
+                if (i + capacity_of_ring <= head_after) continue;
+                std::uint64_t ticks = events[i - from].first;
+                std::uint64_t what = events[i - from].second;
+                if (ticks < start_ticks) continue;
+                std::uint64_t task = what >> 8;
+                const char* lane = priority_names[(what >> 4) & 3];
+                std::ostringstream common;
+                common << "\"pid\":1,\"tid\":" << t << ",\"ts\":" << std::fixed
+                       << (ticks - start_ticks) / ticks_per_us;
+                switch (static_cast<TraceEvent>(what & 15)) {
+                case TraceEvent::Enqueue:
+                    out << ",\n{\"name\":\"enqueue\",\"cat\":\"" << lane << "\",\"ph\":\"i\",\"s\":\"t\","
+                        << common.str() << ",\"args\":{\"task\":" << task << "}}"
+                        << ",\n{\"name\":\"task\",\"cat\":\"queue\",\"ph\":\"s\",\"id\":" << task << ","
+                        << common.str() << "}";
+                    break;
+                case TraceEvent::Steal:
+                    out << ",\n{\"name\":\"steal\",\"cat\":\"" << lane << "\",\"ph\":\"i\",\"s\":\"t\","
+                        << common.str() << ",\"args\":{\"task\":" << task << "}}";
+                    break;
+                case TraceEvent::Begin:
+                    out << ",\n{\"name\":\"task\",\"cat\":\"" << lane << "\",\"ph\":\"B\","
+                        << common.str() << ",\"args\":{\"task\":" << task << "}}"
+                        << ",\n{\"name\":\"task\",\"cat\":\"queue\",\"ph\":\"f\",\"bp\":\"e\",\"id\":"
+                        << task << "," << common.str() << "}";
+                    break;
+                case TraceEvent::End:
+                    out << ",\n{\"name\":\"task\",\"cat\":\"" << lane << "\",\"ph\":\"E\","
+                        << common.str() << "}";
+                    break;
+                }
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+    // One event: its time and (task << 8 | priority << 4 | event). The fields
+    // are atomics only so that write may read a ring while its thread records;
+    // relaxed stores compile to plain moves.
+    struct Slot {
+        std::atomic<std::uint64_t> ticks{0};
+        std::atomic<std::uint64_t> what{0};
+    };
+
+    struct Ring {
+        std::unique_ptr<Slot[]> slots;
+        std::uint64_t mask = 0;
+        std::atomic<std::uint64_t> head{0};  // Events ever recorded; only the owner writes it.
+        std::atomic<std::uint64_t> first{0}; // First event of the current recording.
+        std::thread::id thread;
+        int worker = -1;
+    };
+
+    // Slow path of record: finds or makes the calling thread's ring.
+    Ring* ring_for_thread(int worker) {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        Ring* found = nullptr;
+        for (std::unique_ptr<Ring>& ring : rings) {
+            if (ring->thread == std::this_thread::get_id()) found = ring.get();
+        }
+        if (!found) {
+            rings.emplace_back(new Ring);
+            found = rings.back().get();
+            found->slots.reset(new Slot[capacity]);
+            found->mask = capacity - 1;
+            found->thread = std::this_thread::get_id();
+            found->worker = worker;
+        }
+        cached_tracer = id;
+        cached_ring = found;
+        return found;
+    }
+
+    // Tells the tracers apart even if one is made where another used to be.
+    static std::atomic<std::uint64_t> next_id;
+    const std::uint64_t id = ++next_id;
+
+    std::atomic<bool> on{false};
+    std::mutex rings_mutex;                   // Guards 'rings' and the settings below
+    std::vector<std::unique_ptr<Ring>> rings; // One per thread that has recorded
+    size_t capacity = 1;
+    std::uint64_t start_ticks = 0;
+    std::chrono::steady_clock::time_point start_time;
+
+    // The ring the current thread used last, and whose it is.
+    static thread_local std::uint64_t cached_tracer;
+    static thread_local Ring* cached_ring;
+};
+
+std::atomic<std::uint64_t> TaskTracer::next_id{0};
+thread_local std::uint64_t TaskTracer::cached_tracer = 0;
+thread_local TaskTracer::Ring* TaskTracer::cached_ring = nullptr;
 
 // The ThreadPool class manages a collection of worker threads
-// and a queue of tasks for them to execute.
+// and the queues of tasks for them to execute.
 class ThreadPool {
 public:
+    // What a task can find out about the worker thread running it.
+    struct WorkerInfo {
+        int index = -1; // Worker number, or -1 if the thread is not a pool worker.
+        int cpu = -1;   // CPU the worker is pinned to, or -1 if it is not pinned.
+        int node = -1;  // NUMA node of that CPU, or -1 if it is not pinned.
+    };
+
     // Constructor: Initializes the thread pool with a specified number of threads.
-    ThreadPool(size_t num_threads) : stop(false) {
-        // We create 'num_threads' worker threads. Each thread will run an infinite loop
-        // to pick up and execute tasks from the shared queue.
-        for (size_t i = 0; i < num_threads; ++i) {
-            // emplace_back constructs the std::thread object directly in the vector.
-            // Each thread executes a lambda function as its entry point.
-            workers.emplace_back([this] { // Capture 'this' by value to access member variables
-                for (;;) { // Infinite loop for worker threads to continuously look for tasks
-                    std::function<void()> task; // Placeholder for the task to be executed
-
-                    { // This block defines a scope for the std::unique_lock
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-
-                        // Wait until either the stop flag is set OR there are tasks in the queue.
-                        // The lambda predicate prevents spurious wakeups and ensures the condition is met.
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-
-                        // If the stop flag is true AND the task queue is empty,
-                        // it means the pool is shutting down and there are no more tasks to process.
-                        // This thread can now safely exit its loop and terminate.
-                        if (this->stop && this->tasks.empty())
-                            return; // Worker thread exits
-
-                        // Retrieve the next task from the front of the queue.
-                        // std::move is used for efficiency, as we are taking ownership of the task.
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop(); // Remove the task from the queue
-                    } // The unique_lock goes out of scope here, releasing the mutex.
-                      // This allows other threads to access the queue while the current
-                      // thread executes its task.
-
-                    // Execute the retrieved task.
-                    task();
-                }
-            });
+    // With a Placement other than None every worker is pinned to one CPU, and
+    // the pool keeps one task queue per NUMA node (see worker_loop). 'idle' says
+    // how long idle workers spin before they park. On a single CPU spinning only
+    // takes time away from the thread that would enqueue work, so it is skipped.
+    ThreadPool(size_t num_threads, Placement placement = Placement::None,
+               IdlePolicy idle = IdlePolicy())
+        : ThreadPool(ElasticLimits{num_threads, num_threads}, placement, idle) {}
+
+    // Constructor for an elastic pool: starts limits.min_threads workers and
+    // lets the supervisor add more, up to limits.max_threads, under load.
+    ThreadPool(ElasticLimits limits, Placement placement = Placement::None,
+               IdlePolicy idle = IdlePolicy())
+        : limits(limits), idle_policy(idle), stop(false) {
+        if (limits.max_threads == 0 || limits.min_threads > limits.max_threads)
+            throw std::invalid_argument("ThreadPool: need 0 <= min_threads <= max_threads, max_threads > 0");
+        if (std::thread::hardware_concurrency() <= 1) idle_policy.spins = 0;
+
+        // Decide where each worker runs before starting any of them. A worker
+        // started later by the supervisor takes the place of its slot.
+        std::vector<CpuTopology> cpus;
+        if (placement != Placement::None) cpus = order_cpus(read_cpu_topology(), placement);
+        std::map<int, size_t> queue_of_node;
+        for (size_t i = 0; i < limits.max_threads + limits.blocking_spares; ++i) {
+            WorkerInfo info;
+            info.index = static_cast<int>(i);
+            if (!cpus.empty()) {
+                info.cpu = cpus[i % cpus.size()].cpu;
+                info.node = cpus[i % cpus.size()].node;
+            }
+            if (!queue_of_node.count(info.node)) {
+                size_t queue = queue_of_node.size();
+                queue_of_node[info.node] = queue;
+            }
+            worker_info.push_back(info);
+            worker_queue.push_back(queue_of_node[info.node]);
         }
+        queues.resize(std::max<size_t>(1, queue_of_node.size()));
+
+        // One slot per possible worker. We start 'min_threads' worker threads;
+        // each will run an infinite loop to pick up and execute tasks from the
+        // shared queues.
+        workers.resize(worker_info.size());
+        worker_metrics.reset(new WorkerMetrics[worker_info.size()]);
+        worker_active.resize(worker_info.size(), false);
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            for (size_t i = 0; i < limits.min_threads; ++i) start_worker();
+        }
+        if (elastic()) supervisor = std::thread([this] { supervise(); });
     }
 
     // Destructor: Ensures all worker threads are gracefully stopped and joined.
@@ -62,20 +585,313 @@ public:
             stop = true; // Set the stop flag to true, signaling all workers to terminate
         }
         condition.notify_all(); // Wake up all waiting worker threads so they can check the 'stop' flag
+        supervisor_wake.notify_all();
+        spare_wake.notify_all();
+        if (supervisor.joinable()) supervisor.join();
 
         // Iterate through all worker threads and join them.
         // Joining ensures that each thread completes its current task and
         // reaches its termination condition (the `return` statement in its loop)
-        // before the ThreadPool object is destroyed.
+        // before the ThreadPool object is destroyed. Slots whose worker retired
+        // hold a thread that has already finished.
         for (std::thread& worker : workers) {
-            worker.join(); // Wait for each thread to finish
+            if (worker.joinable()) worker.join(); // Wait for each thread to finish
+        }
+    }
+
+    // Number of worker threads running right now.
+    size_t size() const { return live_workers.load(); }
+
+    // --- Metrics ---
+    // One worker's counters at the time of a snapshot. Slots of retired workers
+    // keep their counts; a worker started later in the slot adds to them.
+    struct WorkerSnapshot {
+        int index = -1;
+        bool running = false;
+        std::uint64_t tasks = 0, steals = 0, parks = 0, wakeups = 0;
+        HistogramSnapshot queue_wait, execution;
+    };
+
+    // The counters of every worker slot that has ever had a worker.
+    std::vector<WorkerSnapshot> metrics() {
+        std::vector<bool> running;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            running = worker_active;
+        }
+        std::vector<WorkerSnapshot> result;
+        for (size_t i = 0; i < worker_info.size(); ++i) {
+            const WorkerMetrics& m = worker_metrics[i];
+            WorkerSnapshot snapshot;
+            snapshot.index = static_cast<int>(i);
+            snapshot.running = running[i];
+            snapshot.tasks = m.tasks.load(std::memory_order_relaxed);
+            snapshot.steals = m.steals.load(std::memory_order_relaxed);
+            snapshot.parks = m.parks.load(std::memory_order_relaxed);
+            snapshot.wakeups = m.wakeups.load(std::memory_order_relaxed);
+            if (!snapshot.running && snapshot.tasks == 0 && snapshot.parks == 0) continue;
+            snapshot.queue_wait = m.queue_wait.snapshot();
+            snapshot.execution = m.execution.snapshot();
+            result.push_back(std::move(snapshot));
         }
+        return result;
+    }
+
+    // Writes the metrics in the Prometheus text format, one series per worker.
+    // Times are in seconds, as Prometheus expects.
+    void write_prometheus(std::ostream& out) {
+        std::vector<WorkerSnapshot> workers_now = metrics();
+        out << "# HELP threadpool_workers Worker threads running.\n"
+            << "# TYPE threadpool_workers gauge\n"
+            << "threadpool_workers " << size() << "\n"
+            << "# HELP threadpool_queued_tasks Tasks waiting in the queues.\n"
+            << "# TYPE threadpool_queued_tasks gauge\n"
+            << "threadpool_queued_tasks " << queued.load() << "\n";
+
+        struct Counter { const char* name; const char* help; std::uint64_t WorkerSnapshot::*field; };
+        const Counter counters[] = {
+            {"threadpool_tasks_total", "Tasks run.", &WorkerSnapshot::tasks},
+            {"threadpool_steals_total", "Tasks taken from another NUMA node's queue.", &WorkerSnapshot::steals},
+            {"threadpool_parks_total", "Times a worker stopped spinning and parked.", &WorkerSnapshot::parks},
+            {"threadpool_wakeups_total", "Times a parked worker was woken to run a task.", &WorkerSnapshot::wakeups},
+        };
+        for (const Counter& counter : counters) {
+            out << "# HELP " << counter.name << " " << counter.help << "\n"
+                << "# TYPE " << counter.name << " counter\n";
+            for (const WorkerSnapshot& worker : workers_now) {
+                out << counter.name << "{worker=\"" << worker.index << "\"} " << worker.*counter.field << "\n";
+            }
+        }
+
+        struct Histogram { const char* name; const char* help; HistogramSnapshot WorkerSnapshot::*field; };
+        const Histogram histograms[] = {
+            {"threadpool_queue_wait_seconds", "Time from enqueue to the start of a task.", &WorkerSnapshot::queue_wait},
+            {"threadpool_execution_seconds", "Run time of a task.", &WorkerSnapshot::execution},
+        };
+        for (const Histogram& histogram : histograms) {
+            out << "# HELP " << histogram.name << " " << histogram.help << "\n"
+                << "# TYPE " << histogram.name << " histogram\n";
+            for (const WorkerSnapshot& worker : workers_now) {
+                const HistogramSnapshot& h = worker.*histogram.field;
+                std::string labels = "worker=\"" + std::to_string(worker.index) + "\"";
+                // Cumulative counts, only at the upper end of non-empty buckets.
+                std::uint64_t cumulative = 0;
+                for (size_t b = 0; b + 1 < h.counts.size(); ++b) {
+                    if (h.counts[b] == 0) continue;
+                    cumulative += h.counts[b];
+                    out << histogram.name << "_bucket{" << labels << ",le=\""
+                        << LatencyHistogram::bucket_floor(b + 1) * 1e-9 << "\"} " << cumulative << "\n";
+                }
+                out << histogram.name << "_bucket{" << labels << ",le=\"+Inf\"} " << h.count << "\n"
+                    << histogram.name << "_sum{" << labels << "} " << h.sum * 1e-9 << "\n"
+                    << histogram.name << "_count{" << labels << "} " << h.count << "\n";
+            }
+        }
+    }
+
+    // Writes the Prometheus text to 'path', for example for the node_exporter
+    // textfile collector. The file is replaced at once, so a scraper never
+    // sees half of it. Returns false if it cannot be written.
+    bool dump_metrics(const std::string& path) {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary);
+            if (!file) return false;
+            write_prometheus(file);
+            if (!file) return false;
+        }
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    // --- Tracing ---
+    // Records every task's enqueue, steal, begin and end from now on, keeping
+    // the last 'events_per_thread' events of each thread. Off by default; when
+    // off, each of those points costs one relaxed load.
+    void start_trace(size_t events_per_thread = 1 << 16) { tracer.start(events_per_thread); }
+    void stop_trace() { tracer.stop(); }
+
+    // Writes what was recorded to 'path' as Chrome trace JSON. Returns false if
+    // it cannot be written.
+    bool write_trace(const std::string& path) { return tracer.write(path); }
+
+    // The worker running the calling thread (index -1 outside any pool).
+    static WorkerInfo current_worker() { return current_info; }
+
+    // Marks a stretch of a task that blocks without using the CPU. While the
+    // region lasts, another worker runs the pool's tasks in this one's place.
+    // Outside this pool's workers, and inside another region, it does nothing.
+    //     {
+    //         ThreadPool::BlockingRegion blocking = pool.blocking_region();
+    //         file.read(buffer, size);
+    //     }
+    class BlockingRegion {
+    public:
+        BlockingRegion(const BlockingRegion&) = delete;
+        BlockingRegion& operator=(const BlockingRegion&) = delete;
+        ~BlockingRegion() {
+            if (pool) pool->end_blocking();
+        }
+
+    private:
+        friend class ThreadPool;
+        explicit BlockingRegion(ThreadPool* pool) : pool(pool) {}
+        ThreadPool* pool;
+    };
+
+    BlockingRegion blocking_region() {
+        return BlockingRegion(current_pool == this && !in_blocking_region ? begin_blocking() : nullptr);
+    }
+
+    // --- Data-parallel algorithms ---
+    // These split a loop over [begin, end) into chunks and run the chunks on the
+    // pool's workers AND on the calling thread. Because the caller works too, it
+    // never sits idle waiting for the pool, and calling them from inside a task
+    // that already runs on the pool cannot deadlock: if every worker is busy, the
+    // caller simply does all the chunks itself. The call returns once every chunk
+    // is done; an exception thrown by the body is rethrown in the caller.
+
+    // Calls body(i) for every i in [begin, end). 'grain' is the smallest chunk
+    // (Static ignores it unless the blocks would be smaller).
+    template<class Body>
+    void parallel_for(size_t begin, size_t end, size_t grain, Body body,
+                      Partition partition = Partition::Dynamic) {
+        for_each_chunk(begin, end, grain, partition, [&body](size_t chunk_begin, size_t chunk_end) {
+            for (size_t i = chunk_begin; i < chunk_end; ++i) body(i);
+        });
+    }
+
+    // Returns combine(...combine(combine(identity, map(begin)), map(begin + 1))..., map(end - 1))
+    // computed in parallel. Each chunk is reduced on its own and the chunk results
+    // are combined in index order at the end, so the result does not depend on
+    // which thread ran which chunk (this matters for floating point sums).
+    // 'combine' must be associative.
+    template<class T, class Map, class Combine>
+    T parallel_reduce(size_t begin, size_t end, size_t grain, T identity, Map map, Combine combine,
+                      Partition partition = Partition::Dynamic) {
+        std::mutex results_mutex;
+        std::vector<std::pair<size_t, T>> results; // (chunk begin, chunk result)
+        for_each_chunk(begin, end, grain, partition, [&](size_t chunk_begin, size_t chunk_end) {
+            T value = identity;
+            for (size_t i = chunk_begin; i < chunk_end; ++i) value = combine(value, map(i));
+            std::lock_guard<std::mutex> lock(results_mutex);
+            results.emplace_back(chunk_begin, std::move(value));
+        });
+        std::sort(results.begin(), results.end(),
+                  [](const std::pair<size_t, T>& a, const std::pair<size_t, T>& b) {
+                      return a.first < b.first;
+                  });
+        T total = identity;
+        for (std::pair<size_t, T>& result : results) total = combine(total, result.second);
+        return total;
+    }
+
+    // Writes op(first[i]) to out[i] for every element of [first, last), like
+    // std::transform. Both iterators must be random access.
+    template<class InputIt, class OutputIt, class Op>
+    void parallel_transform(InputIt first, InputIt last, OutputIt out, size_t grain, Op op,
+                            Partition partition = Partition::Dynamic) {
+        size_t count = static_cast<size_t>(last - first);
+        for_each_chunk(0, count, grain, partition, [&](size_t chunk_begin, size_t chunk_end) {
+            for (size_t i = chunk_begin; i < chunk_end; ++i) out[i] = op(first[i]);
+        });
     }
 
     // Enqueue method: Adds a new task to the task queue.
     // It uses a template to accept any callable object (function, lambda, functor).
+    // Tasks enqueued without a priority go to the Normal lane.
     template<class F>
     void enqueue(F&& f) {
+        enqueue(Priority::Normal, std::forward<F>(f));
+    }
+
+    // Adds a task to the given priority lane.
+    template<class F>
+    void enqueue(Priority priority, F&& f) {
+        enqueue_task(priority, Clock::now() + lane_target(priority), std::forward<F>(f));
+    }
+
+    // Adds a task that should start by 'deadline'. Among all queued tasks, the
+    // one with the earliest deadline runs first; tasks without an explicit
+    // deadline take part with their lane's target as their deadline.
+    template<class F>
+    void enqueue(Priority priority, std::chrono::steady_clock::time_point deadline, F&& f) {
+        enqueue_task(priority, deadline, std::forward<F>(f));
+    }
+
+    // Adds every callable in [first, last) to the Normal lane at once.
+    template<class Iterator>
+    void enqueue_bulk(Iterator first, Iterator last) {
+        enqueue_bulk(Priority::Normal, first, last);
+    }
+
+    // Adds every callable in [first, last) to the given lane. Enqueuing them one
+    // by one would take the lock and possibly make a wake-up system call per
+    // task; here the lock is taken once, and only as many parked workers are
+    // woken as there are tasks left over for them: spinning workers find tasks
+    // by themselves, and a worker woken for nothing only goes back to sleep.
+    template<class Iterator>
+    void enqueue_bulk(Priority priority, Iterator first, Iterator last) {
+        // Wrap the callables before taking the lock; under it they are only moved.
+        std::vector<Task> tasks;
+        Clock::time_point now = Clock::now();
+        for (; first != last; ++first) {
+            Task task;
+            task.function = *first;
+            task.priority = priority;
+            task.due = now + lane_target(priority);
+            task.enqueued = now;
+            tasks.push_back(std::move(task));
+        }
+        if (tasks.empty()) return;
+
+        size_t wake = 0;
+        { // This block defines a scope for the std::unique_lock
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (stop)
+                throw std::runtime_error("enqueue on stopped ThreadPool");
+            for (Task& task : tasks) push_task(std::move(task));
+            if (live_workers == 0) start_worker();
+
+            size_t searching = static_cast<size_t>(spinning.load());
+            size_t left_over = tasks.size() > searching ? tasks.size() - searching : 0;
+            wake = std::min(left_over, static_cast<size_t>(parked.load()));
+        }
+        if (wake > 0 && wake >= static_cast<size_t>(parked.load())) {
+            condition.notify_all();
+        } else {
+            for (size_t w = 0; w < wake; ++w) condition.notify_one();
+        }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // A queued task, the lane it came from and when it is due.
+    struct Task {
+        std::function<void()> function;
+        Priority priority = Priority::Normal;
+        Clock::time_point due;
+        Clock::time_point enqueued;      // For the queue wait metric and the supervisor.
+        unsigned long long sequence = 0; // Breaks ties in enqueue order (FIFO).
+    };
+
+    // Heap order for the task queues: the task that is due first ends up at the front.
+    struct DueLater {
+        bool operator()(const Task& a, const Task& b) const {
+            return a.due != b.due ? a.due > b.due : a.sequence > b.sequence;
+        }
+    };
+
+    static Clock::duration lane_target(Priority priority) {
+        switch (priority) {
+        case Priority::High: return HIGH_LANE_TARGET;
+        case Priority::Low: return LOW_LANE_TARGET;
+        default: return NORMAL_LANE_TARGET;
+        }
+    }
+
+    template<class F>
+    void enqueue_task(Priority priority, Clock::time_point due, F&& f) {
         { // This block defines a scope for the std::unique_lock
             std::unique_lock<std::mutex> lock(queue_mutex);
 
@@ -83,22 +899,527 @@ public:
             if (stop)
                 throw std::runtime_error("enqueue on stopped ThreadPool");
 
-            // Add the task to the queue. std::forward ensures perfect forwarding,
+            // Add the task to the heap. std::forward ensures perfect forwarding,
             // preserving the value category (lvalue/rvalue) of 'f'.
             // std::function will then copy or move the callable as needed.
-            tasks.emplace(std::forward<F>(f));
+            Task task;
+            task.function = std::forward<F>(f);
+            task.priority = priority;
+            task.due = due;
+            task.enqueued = Clock::now();
+            push_task(std::move(task));
+
+            // An elastic pool may have retired every worker.
+            if (live_workers == 0) start_worker();
         }
-        condition.notify_one(); // Wake up one waiting worker thread to process the new task
+        // Wake up one parked worker to process the new task, unless a spinning
+        // worker is about to take it anyway.
+        if (spinning.load() == 0 && parked.load() > 0) condition.notify_one();
     }
 
-private:
-    std::vector<std::thread> workers;               // Collection of worker threads
-    std::queue<std::function<void()>> tasks;        // Queue of tasks (functions without return values)
+    // Puts a task in a queue. Must hold queue_mutex.
+    void push_task(Task&& task) {
+        task.sequence = next_sequence++;
+        if (tracer.enabled()) trace(TraceEvent::Enqueue, task);
+
+        // A worker keeps the tasks it spawns on its own node, where their data
+        // probably is. Tasks from outside the pool are spread over the nodes.
+        size_t queue = current_pool == this ? worker_queue[current_info.index]
+                                            : next_sequence % queues.size();
+        queues[queue].push_back(std::move(task));
+        std::push_heap(queues[queue].begin(), queues[queue].end(), DueLater());
+        ++queued;
+    }
+
+    // The loop every worker thread runs: wait for a task, run it, repeat.
+    void worker_loop(size_t index) {
+        current_pool = this;
+        current_info = worker_info[index];
+        if (current_info.cpu >= 0) {
+            // Pin the thread so the kernel cannot move it away from its caches.
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(current_info.cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+
+        WorkerMetrics& stats = worker_metrics[index];
+
+        for (;;) { // Infinite loop for worker threads to continuously look for tasks
+            Task task; // Placeholder for the task to be executed
+
+            // One worker too many since a blocking_region ended: wait as a spare.
+            if (active_workers() > limits.max_threads) {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                if (active_workers() > limits.max_threads && !wait_as_spare(lock)) {
+                    retire(index);
+                    return;
+                }
+            }
+
+            bool parking = !spin_for_task();
+            if (parking) bump(stats.parks);
+
+            { // This block defines a scope for the std::unique_lock
+                std::unique_lock<std::mutex> lock(queue_mutex);
+
+                // Wait until either the stop flag is set OR there are tasks in a queue.
+                // The lambda predicate prevents spurious wakeups and ensures the condition is met.
+                // If a task arrived after we stopped spinning, it returns at once.
+                auto ready = [this]{ return stop || queued > 0; };
+                if (!parking && !ready()) {
+                    // We saw a task while spinning, but another worker took it
+                    // first. Only parked workers get woken, and we are not
+                    // counted as one, so look again rather than wait here.
+                    continue;
+                }
+                if (parking && elastic() && !condition.wait_for(lock, limits.idle_timeout, ready) &&
+                    live_workers > limits.min_threads) {
+                    // Parked for idle_timeout with nothing to do: retire. The
+                    // slot's thread is joined when the slot is reused.
+                    --parked;
+                    retire(index);
+                    return;
+                }
+                condition.wait(lock, ready);
+                if (parking) {
+                    --parked;
+                    if (queued > 0) bump(stats.wakeups);
+                }
+
+                // If the stop flag is true AND the task queues are empty,
+                // it means the pool is shutting down and there are no more tasks to process.
+                // This thread can now safely exit its loop and terminate.
+                if (stop && queued == 0)
+                    return; // Worker thread exits
+
+                if (take_task(worker_queue[index], task)) {
+                    bump(stats.steals);
+                    if (tracer.enabled()) trace(TraceEvent::Steal, task);
+                }
+
+                // enqueue skips the wake-up while someone spins, so the last worker
+                // to stop spinning passes it on if more tasks are waiting.
+                if (queued > 0 && spinning.load() == 0 && parked.load() > 0) condition.notify_one();
+            } // The unique_lock goes out of scope here, releasing the mutex.
+              // This allows other threads to access the queues while the current
+              // thread executes its task.
+
+            // Execute the retrieved task. Work it enqueues for parallel loops
+            // runs in the same lane.
+            current_priority = task.priority;
+            Clock::time_point started = Clock::now();
+            stats.queue_wait.record(nanoseconds(started - task.enqueued));
+            if (tracer.enabled()) trace(TraceEvent::Begin, task);
+            task.function();
+            if (tracer.enabled()) trace(TraceEvent::End, task);
+            stats.execution.record(nanoseconds(Clock::now() - started));
+            bump(stats.tasks);
+        }
+    }
+
+    bool elastic() const { return limits.min_threads < limits.max_threads; }
+
+    void trace(TraceEvent event, const Task& task) {
+        tracer.record(event, task.sequence, task.priority, current_pool == this ? current_info.index : -1);
+    }
+
+    static std::uint64_t nanoseconds(Clock::duration duration) {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    // Workers that can take tasks: neither in a blocking_region nor spare.
+    size_t active_workers() const {
+        return live_workers.load() - blocked_workers.load() - spare_workers.load();
+    }
+
+    // Starts a worker in the first free slot. Must hold queue_mutex, and
+    // live_workers must be below the number of slots.
+    void start_worker() {
+        size_t index = 0;
+        while (worker_active[index]) ++index;
+        // A retired worker has let go of the lock for good, so this is quick.
+        if (workers[index].joinable()) workers[index].join();
+        worker_active[index] = true;
+        ++live_workers;
+        // Each thread executes worker_loop as its entry point.
+        workers[index] = std::thread([this, index] { worker_loop(index); });
+    }
+
+    // Ends worker 'index'. Its thread must return from worker_loop right after,
+    // still holding queue_mutex.
+    void retire(size_t index) {
+        worker_active[index] = false;
+        --live_workers;
+    }
+
+    // Parks a worker left over by a blocking_region until a new region needs it.
+    // Returns false if none did within idle_timeout. Must hold queue_mutex.
+    bool wait_as_spare(std::unique_lock<std::mutex>& lock) {
+        ++spare_workers;
+        bool needed = spare_wake.wait_for(lock, limits.idle_timeout, [this] {
+            return stop || active_workers() < limits.max_threads;
+        });
+        --spare_workers;
+        return needed;
+    }
+
+    // A worker enters a blocking_region. If nobody else is free to take its
+    // place, wake a spare or start one.
+    ThreadPool* begin_blocking() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        in_blocking_region = true;
+        ++blocked_workers;
+        if (!stop && active_workers() < limits.max_threads &&
+            spinning.load() == 0 && parked.load() == 0) {
+            if (spare_workers > 0) {
+                spare_wake.notify_one();
+            } else if (live_workers < workers.size()) {
+                start_worker();
+            }
+        }
+        return this;
+    }
+
+    void end_blocking() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        in_blocking_region = false;
+        --blocked_workers;
+    }
+
+    // The supervisor of an elastic pool: a few times per grow_after, checks
+    // whether the task due next in some queue has waited too long while no
+    // worker was free, and if so starts one more worker.
+    void supervise() {
+        Clock::duration interval = std::max<Clock::duration>(limits.grow_after / 2,
+                                                             std::chrono::milliseconds(1));
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (!stop) {
+            supervisor_wake.wait_for(lock, interval);
+            if (stop || queued == 0 || active_workers() >= limits.max_threads) continue;
+            if (live_workers >= workers.size()) continue;
+            if (spinning.load() > 0 || parked.load() > 0) continue;
+            Clock::time_point now = Clock::now();
+            for (const std::vector<Task>& queue : queues) {
+                if (!queue.empty() && now - queue.front().enqueued > limits.grow_after) {
+                    start_worker();
+                    break;
+                }
+            }
+        }
+    }
+
+    // Spins, then yields, while watching the queues without the lock. Returns
+    // true as soon as there is a task (or the pool stops). Returns false if the
+    // worker should park; it is then already counted as parked.
+    bool spin_for_task() {
+        ++spinning;
+        for (unsigned i = 0; i < idle_policy.spins + idle_policy.yields; ++i) {
+            if (queued.load(std::memory_order_relaxed) > 0 || stop.load(std::memory_order_relaxed)) {
+                --spinning;
+                return true;
+            }
+            if (i < idle_policy.spins) {
+                cpu_relax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        // Count as parked before we stop counting as spinning, so that enqueue
+        // always sees us in one of the two.
+        ++parked;
+        --spinning;
+        return false;
+    }
+
+    // Takes a task for a worker whose own node has queue 'home'. The worker
+    // prefers its own node's queue, where the task's data probably is, and
+    // steals the task due first on another node when its own queue is empty.
+    // It also steals when that task is due before its own and is either
+    // overdue or in a more urgent lane, so that locality never makes urgent
+    // work wait behind less urgent work. Must hold queue_mutex, and at least
+    // one queue must have a task. Returns true if the task was stolen.
+    bool take_task(size_t home, Task& task) {
+        size_t from = home;
+        size_t other = queues.size(); // Queue of the task due first on another node.
+        for (size_t q = 0; q < queues.size(); ++q) {
+            if (q == home || queues[q].empty()) continue;
+            if (other == queues.size() || DueLater()(queues[other].front(), queues[q].front())) {
+                other = q;
+            }
+        }
+        if (other != queues.size()) {
+            if (queues[home].empty()) {
+                from = other;
+            } else {
+                const Task& local = queues[home].front();
+                const Task& remote = queues[other].front();
+                if (DueLater()(local, remote) &&
+                    (remote.priority < local.priority || remote.due <= Clock::now())) {
+                    from = other;
+                }
+            }
+        }
+        // The heap has the task due first at the front; pop_heap moves it to the back.
+        // std::move is used for efficiency, as we are taking ownership of the task.
+        std::pop_heap(queues[from].begin(), queues[from].end(), DueLater());
+        task = std::move(queues[from].back());
+        queues[from].pop_back(); // Remove the task from the queue
+        --queued;
+        return from != home;
+    }
+
+    // Lane of the task the current thread is running (Normal outside the pool).
+    static thread_local Priority current_priority;
+    // The pool and worker the current thread belongs to, if any.
+    static thread_local ThreadPool* current_pool;
+    static thread_local WorkerInfo current_info;
+    // Whether the current thread is inside a blocking_region.
+    static thread_local bool in_blocking_region;
+
+    // Shared by the caller and the helper tasks of one for_each_chunk call. It
+    // lives in a shared_ptr because a helper may only get to run after the loop
+    // is over; it then finds no chunk left and returns without touching anything
+    // that belonged to the caller.
+    struct LoopState {
+        std::atomic<size_t> next{0};  // First index not handed out yet.
+        size_t end = 0;
+        size_t grain = 1;
+        size_t participants = 1;
+        Partition partition = Partition::Dynamic;
+
+        std::mutex done_mutex;
+        std::condition_variable done_condition;
+        size_t remaining = 0;         // Indices handed out or not, but not finished.
+        std::exception_ptr error;     // First exception thrown by the body (under done_mutex).
+        std::atomic<bool> failed{false}; // Set with 'error', checked without the lock.
+
+        // Claims the next chunk. Returns false when the range is used up.
+        bool claim(size_t& chunk_begin, size_t& chunk_end) {
+            size_t current = next.load();
+            for (;;) {
+                if (current >= end) return false;
+                size_t left = end - current;
+                size_t size = grain;
+                if (partition == Partition::Static) {
+                    size = std::max(grain, (end + participants - 1) / participants);
+                } else if (partition == Partition::Guided) {
+                    size = std::max(grain, left / (2 * participants));
+                }
+                size = std::min(size, left);
+                if (next.compare_exchange_weak(current, current + size)) {
+                    chunk_begin = current;
+                    chunk_end = current + size;
+                    return true;
+                }
+            }
+        }
+
+        // Marks 'count' indices as finished and wakes the caller after the last one.
+        void finish(size_t count) {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            remaining -= count;
+            if (remaining == 0) done_condition.notify_all();
+        }
+    };
+
+    // Runs chunk(chunk_begin, chunk_end) over [begin, end) on the pool and the
+    // calling thread, and returns when all of it is done.
+    template<class Chunk>
+    void for_each_chunk(size_t begin, size_t end, size_t grain, Partition partition, Chunk chunk) {
+        if (begin >= end) return;
+        auto state = std::make_shared<LoopState>();
+        // Work on [0, end - begin) so Static blocks are measured from 0.
+        state->end = end - begin;
+        state->grain = std::max<size_t>(1, grain);
+        state->participants = size() + 1;
+        state->partition = partition;
+        state->remaining = end - begin;
+
+        // Takes chunks until none are left. Every participant runs this loop.
+        auto work = [state, begin, &chunk] {
+            size_t chunk_begin, chunk_end;
+            while (state->claim(chunk_begin, chunk_end)) {
+                if (!state->failed.load()) {
+                    try {
+                        chunk(begin + chunk_begin, begin + chunk_end);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(state->done_mutex);
+                        if (!state->error) state->error = std::current_exception();
+                        state->failed = true;
+                    }
+                }
+                state->finish(chunk_end - chunk_begin);
+            }
+        };
+
+        // One helper per worker at most, and no more than there are chunks to share.
+        size_t chunks = (state->end + state->grain - 1) / state->grain;
+        size_t helpers = std::min(size(), chunks - 1);
+        std::vector<std::function<void()>> helper_tasks(helpers, work);
+        enqueue_bulk(current_priority, helper_tasks.begin(), helper_tasks.end());
+        work();
+
+        // Only chunks that a helper has already claimed can still be running.
+        std::unique_lock<std::mutex> lock(state->done_mutex);
+        state->done_condition.wait(lock, [&] { return state->remaining == 0; });
+        if (state->error) std::rethrow_exception(state->error);
+    }
+
+    ElasticLimits limits;                           // How many workers, and when to add or retire one
+    std::vector<std::thread> workers;               // One slot per possible worker thread
+    std::vector<bool> worker_active;                // Which slots have a running worker (under the lock)
+    std::atomic<size_t> live_workers{0};            // Running workers (changed under the lock)
+    std::atomic<size_t> blocked_workers{0};         // Of those, inside a blocking_region (same)
+    std::atomic<size_t> spare_workers{0};           // Of those, waiting as spares (same)
+    std::condition_variable spare_wake;             // Wakes a spare when a blocking_region needs it
+    std::thread supervisor;                         // Grows an elastic pool; not started otherwise
+    std::condition_variable supervisor_wake;        // Wakes the supervisor early when the pool stops
+    std::vector<WorkerInfo> worker_info;            // Where each worker runs
+    std::vector<size_t> worker_queue;               // Which queue each worker calls home
+    std::vector<std::vector<Task>> queues;          // One heap of tasks per NUMA node, due first at the front
+    std::unique_ptr<WorkerMetrics[]> worker_metrics; // Counters of each worker slot
+    std::atomic<size_t> queued{0};                  // Tasks in all queues (changed under the lock)
+    unsigned long long next_sequence = 0;           // Enqueue counter, for FIFO order within a lane
 
     std::mutex queue_mutex;                         // Mutex to protect access to the task queue
     std::condition_variable condition;              // Condition variable to signal workers about new tasks
 
-    bool stop;                                      // Flag to signal worker threads to stop
+    IdlePolicy idle_policy;                         // How long idle workers spin before parking
+    std::atomic<int> spinning{0};                   // Workers looking for a task without the lock
+    std::atomic<int> parked{0};                     // Workers asleep (or about to be) on 'condition'
+
+    TaskTracer tracer;                              // Off until start_trace
+
+    std::atomic<bool> stop;                         // Flag to signal worker threads to stop
+};
+
+thread_local Priority ThreadPool::current_priority = Priority::Normal;
+thread_local ThreadPool* ThreadPool::current_pool = nullptr;
+thread_local ThreadPool::WorkerInfo ThreadPool::current_info;
+thread_local bool ThreadPool::in_blocking_region = false;
+
+// A TaskGraph is a fixed set of tasks with "must run after" edges between them
+// (a directed acyclic graph, or DAG). Think of one frame of a video pipeline:
+// decode, then two filters that can run side by side, then composite, then encode.
+//
+// Each node counts how many of its predecessors are still unfinished. When a
+// node finishes it decrements that count on each of its successors, and a
+// successor whose count reaches zero is ready: the finishing thread runs the
+// first ready successor itself (no trip through the queue) and enqueues the
+// others. No thread ever waits for a dependency.
+//
+// The graph is built once and can then be run as often as needed. A run only
+// resets the counters; nodes, edges and task closures are never reallocated.
+class TaskGraph {
+public:
+    using NodeId = size_t;
+
+    // Adds a node that runs 'work' once all of 'predecessors' have finished.
+    // Predecessors must already be in the graph, which also makes cycles impossible.
+    NodeId add(std::function<void()> work, std::initializer_list<NodeId> predecessors = {}) {
+        NodeId id = nodes.size();
+        nodes.emplace_back();
+        nodes.back().work = std::move(work);
+        for (NodeId predecessor : predecessors) {
+            if (predecessor >= id) throw std::invalid_argument("TaskGraph: unknown predecessor");
+            nodes[predecessor].successors.push_back(id);
+            ++nodes.back().predecessor_count;
+        }
+        if (predecessors.size() == 0) roots.push_back(id);
+        return id;
+    }
+
+    size_t size() const { return nodes.size(); }
+
+    // Runs every node once on 'pool', in the given priority lane, and returns
+    // when all have finished. The calling thread runs the first root itself. If a node throws, the nodes
+    // that have not started yet are skipped and the first exception is rethrown.
+    // A graph must not be run twice at the same time, and it must not be run from
+    // a task of the same pool if that could leave no worker free for its nodes.
+    void run(ThreadPool& pool, Priority priority = Priority::Normal) {
+        if (nodes.empty()) return;
+        if (running.exchange(true)) throw std::logic_error("TaskGraph: already running");
+        this->pool = &pool;
+        this->priority = priority;
+        error = nullptr;
+        failed = false;
+        finished = false;
+        for (Node& node : nodes) node.pending.store(node.predecessor_count);
+        remaining.store(nodes.size());
+
+        for (size_t r = 1; r < roots.size(); ++r) {
+            NodeId root = roots[r];
+            pool.enqueue(priority, [this, root] { execute(root); });
+        }
+        execute(roots[0]);
+
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_condition.wait(lock, [this] { return finished; });
+        running = false;
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    struct Node {
+        std::function<void()> work;
+        std::vector<NodeId> successors;
+        size_t predecessor_count = 0;
+        std::atomic<size_t> pending{0}; // Predecessors not finished in this run.
+    };
+
+    // Runs node 'id' and then, as long as that makes one ready, its successors.
+    void execute(NodeId id) {
+        for (;;) {
+            Node& node = nodes[id];
+            if (!failed.load()) {
+                try {
+                    node.work();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    if (!error) error = std::current_exception();
+                    failed = true;
+                }
+            }
+
+            const NodeId none = nodes.size();
+            NodeId next = none;
+            for (NodeId successor : node.successors) {
+                if (nodes[successor].pending.fetch_sub(1) != 1) continue;
+                if (next == none) {
+                    next = successor;
+                } else {
+                    pool->enqueue(priority, [this, successor] { execute(successor); });
+                }
+            }
+
+            if (remaining.fetch_sub(1) == 1) {
+                // Last node of the run. run() waits for 'finished', not for
+                // 'remaining', and we set it and notify under the lock: run()
+                // cannot return (and the graph go away) before we let go of it.
+                std::lock_guard<std::mutex> lock(done_mutex);
+                finished = true;
+                done_condition.notify_all();
+            }
+            if (next == none) return;
+            id = next;
+        }
+    }
+
+    // std::deque never moves its elements, which the atomics require.
+    std::deque<Node> nodes;
+    std::vector<NodeId> roots;
+
+    ThreadPool* pool = nullptr;
+    Priority priority = Priority::Normal;
+    std::atomic<bool> running{false};
+    std::atomic<size_t> remaining{0}; // Nodes not finished in this run.
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex done_mutex;
+    std::condition_variable done_condition;
+    bool finished = false;            // Set under done_mutex by the last node of a run.
 };
 
 // --- Example Usage ---
@@ -113,14 +1434,17 @@ int main() {
 
     // 2. Enqueue Tasks:
     // We add 10 tasks to the pool. Each task is a lambda function that prints a message
-    // and simulates some work with a short sleep.
+    // and simulates some work with a short sleep. Sleeping does not use the CPU,
+    // so the task says so with a blocking_region and a spare worker carries on
+    // with the queue meanwhile.
     std::cout << "Enqueuing 10 tasks..." << std::endl;
     for (int i = 0; i < 10; ++i) {
-        pool.enqueue([i] { // This is a lambda function acting as our task.
+        pool.enqueue([i, &pool] { // This is a lambda function acting as our task.
             std::cout << "Task " << i
                       << " is running in thread ID: " << std::this_thread::get_id()
                       << std::endl;
             // Simulate some work being done by the task
+            ThreadPool::BlockingRegion blocking = pool.blocking_region();
             std::this_thread::sleep_for(std::chrono::milliseconds(200));
         });
     }
@@ -138,6 +1462,179 @@ int main() {
     std::this_thread::sleep_for(std::chrono::seconds(3));
     std::cout << "Main thread done sleeping. Thread pool will now be destroyed." << std::endl;
 
+    // 4. Data-parallel loops:
+    // parallel_for, parallel_reduce and parallel_transform do the chunking and the
+    // waiting for us. Here we fill a small grayscale "image" row by row. Rows near
+    // the middle cost more, so Dynamic partitioning keeps every thread busy.
+    const size_t width = 320, height = 240;
+    std::vector<int> pixels(width * height);
+    pool.parallel_for(0, height, 4, [&](size_t y) {
+        for (size_t x = 0; x < width; ++x) {
+            // A little iterative work per pixel, heavier in the middle rows.
+            size_t steps = 1 + (height / 2 - (y > height / 2 ? y - height / 2 : height / 2 - y));
+            int value = 0;
+            for (size_t k = 0; k < steps; ++k) value = (value * 31 + static_cast<int>(x ^ y)) & 255;
+            pixels[y * width + x] = value;
+        }
+    });
+
+    // Sum of all pixels. The chunks are combined in index order, so the result is
+    // the same on every run whatever the thread timing.
+    long long brightness = pool.parallel_reduce(
+        0, pixels.size(), 4096, 0LL,
+        [&](size_t i) { return static_cast<long long>(pixels[i]); },
+        [](long long a, long long b) { return a + b; }, Partition::Guided);
+
+    // Threshold the image into black and white with one big block per thread.
+    std::vector<unsigned char> mask(pixels.size());
+    pool.parallel_transform(pixels.begin(), pixels.end(), mask.begin(), 4096,
+                            [](int value) { return static_cast<unsigned char>(value >= 128); },
+                            Partition::Static);
+    size_t white = 0;
+    for (unsigned char m : mask) white += m;
+    std::cout << "Image " << width << "x" << height << ": brightness sum " << brightness
+              << ", " << white << " pixels above threshold" << std::endl;
+
+    // 5. Priorities:
+    // Batch work goes to the Low lane; an interactive request enqueued after it
+    // in the High lane still starts first, as soon as a worker is free.
+    std::mutex order_mutex;
+    std::vector<std::string> order;
+    ThreadPool single(1);
+    single.enqueue([] { std::this_thread::sleep_for(std::chrono::milliseconds(50)); });
+    for (int i = 0; i < 3; ++i) {
+        single.enqueue(Priority::Low, [&, i] {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back("batch" + std::to_string(i));
+        });
+    }
+    single.enqueue(Priority::High, [&] {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        order.push_back("interactive");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        std::cout << "Run order:";
+        for (const std::string& name : order) std::cout << " " << name;
+        std::cout << std::endl;
+    }
+
+    // 6. Placement:
+    // A pool whose workers are pinned one per core, spread over the sockets.
+    // Each task can ask which worker, CPU and NUMA node it runs on.
+    std::vector<CpuTopology> topology = read_cpu_topology();
+    std::cout << "This machine: " << topology.size() << " CPUs available" << std::endl;
+    {
+        ThreadPool pinned(2, Placement::Scatter);
+        std::mutex print_mutex;
+        pinned.parallel_for(0, 4, 1, [&](size_t i) {
+            ThreadPool::WorkerInfo me = ThreadPool::current_worker();
+            std::lock_guard<std::mutex> lock(print_mutex);
+            std::cout << "Item " << i << " ran on "
+                      << (me.index < 0 ? std::string("the calling thread")
+                                       : "worker " + std::to_string(me.index) + " (CPU " +
+                                             std::to_string(me.cpu) + ", node " +
+                                             std::to_string(me.node) + ")")
+                      << std::endl;
+        });
+    }
+
+    // 7. Wake-up latency:
+    // One task at a time, each enqueued after the previous one has finished, so
+    // the worker is idle every time a task arrives. A pool that parks at once pays
+    // a full wake-up per task; a pool that spins a little usually does not.
+    auto average_round_trip = [](IdlePolicy idle) {
+        ThreadPool quick(1, Placement::None, idle);
+        const int rounds = 2000;
+        std::atomic<int> done{0};
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            quick.enqueue([&] { ++done; });
+            while (done.load() <= i) std::this_thread::yield();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / rounds;
+    };
+    IdlePolicy park_at_once;
+    park_at_once.spins = 0;
+    park_at_once.yields = 0;
+    std::cout << "Round trip per task: " << average_round_trip(park_at_once)
+              << " us parking at once, " << average_round_trip(IdlePolicy())
+              << " us spinning first" << std::endl;
+
+    // 8. Task graphs:
+    // A frame pipeline where the two filters only depend on the decoder and can
+    // run in parallel. We build the graph once and run it for several frames.
+    int frame = 0;
+    std::atomic<int> decoded{0}, sharpened{0}, denoised{0}, encoded{0};
+    TaskGraph pipeline;
+    TaskGraph::NodeId decode = pipeline.add([&] { decoded = frame; });
+    TaskGraph::NodeId sharpen = pipeline.add([&] { sharpened = decoded.load(); }, {decode});
+    TaskGraph::NodeId denoise = pipeline.add([&] { denoised = decoded.load(); }, {decode});
+    TaskGraph::NodeId composite = pipeline.add([&] { encoded = sharpened + denoised; },
+                                               {sharpen, denoise});
+    pipeline.add([&] {
+        std::cout << "Frame " << frame << " encoded as " << encoded << std::endl;
+    }, {composite});
+    for (frame = 1; frame <= 3; ++frame) {
+        pipeline.run(pool);
+    }
+
+    // 9. Elastic pools:
+    // A burst of tasks that mostly wait (like I/O) on a pool that starts with one
+    // worker. The supervisor adds workers while tasks queue up; once the burst is
+    // over they retire again after their idle timeout.
+    {
+        ElasticLimits limits;
+        limits.min_threads = 1;
+        limits.max_threads = 4;
+        limits.grow_after = std::chrono::milliseconds(5);
+        limits.idle_timeout = std::chrono::milliseconds(200);
+        ThreadPool elastic(limits);
+        std::atomic<int> finished{0};
+        std::vector<std::function<void()>> burst(16, [&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ++finished;
+        });
+        elastic.enqueue_bulk(burst.begin(), burst.end());
+        size_t busiest = 0;
+        while (finished < 16) {
+            busiest = std::max(busiest, elastic.size());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::cout << "Elastic pool: " << busiest << " workers during the burst";
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        std::cout << ", " << elastic.size() << " after it" << std::endl;
+    }
+
+    // 10. Metrics:
+    // What the main pool has done so far, per worker, and the same numbers in
+    // the Prometheus text format for a monitoring system to pick up.
+    for (const ThreadPool::WorkerSnapshot& worker : pool.metrics()) {
+        std::cout << "Worker " << worker.index << ": " << worker.tasks << " tasks, "
+                  << worker.steals << " steals, " << worker.parks << " parks, "
+                  << worker.wakeups << " wakeups, queue wait p50 "
+                  << worker.queue_wait.percentile(0.5) / 1000 << " us p99 "
+                  << worker.queue_wait.percentile(0.99) / 1000 << " us" << std::endl;
+    }
+    if (pool.dump_metrics("threadpool_metrics.prom")) {
+        std::cout << "Metrics written to threadpool_metrics.prom" << std::endl;
+    }
+
+    // 11. Tracing:
+    // Record a few frames of the pipeline and a parallel loop, then write the
+    // timeline. Open the file in chrome://tracing or https://ui.perfetto.dev.
+    pool.start_trace();
+    for (frame = 4; frame <= 5; ++frame) {
+        pipeline.run(pool);
+    }
+    pool.parallel_for(0, 1000, 50, [](size_t i) { volatile size_t x = i * i; (void)x; });
+    pool.stop_trace();
+    if (pool.write_trace("threadpool_trace.json")) {
+        std::cout << "Trace written to threadpool_trace.json" << std::endl;
+    }
+
     // When 'pool' goes out of scope here, its destructor will be called,
     // which will stop all worker threads and join them.
     std::cout << "--- Thread Pool Demonstration Complete ---" << std::endl;